@@ -0,0 +1,374 @@
+#pragma once
+
+#include "geometry.hpp"
+#include "ring_kernel.hpp"
+#include "economy.hpp"
+#include "province_queries.hpp"
+#include <chrono>
+#include <random>
+#include <iostream>
+#include <cstdio>
+
+// Micro-benchmarks for the hot kernels, run with --bench (no window is opened)
+
+// Keeps results alive so the compiler can't drop the measured loops
+static volatile uint32_t benchmark_sink = 0;
+
+template<typename Fn>
+double benchmarkNanoseconds(size_t operations, Fn&& fn)
+{
+	// Warm up caches and branch predictors once, then time the best of a few runs
+	fn();
+
+	double best = 1e30;
+	for(int run = 0; run < 5; ++run)
+	{
+		auto start = chrono::steady_clock::now();
+		fn();
+		double ns = chrono::duration<double, nano>(chrono::steady_clock::now() - start).count();
+		best = min(best, ns);
+	}
+
+	return best / (double)operations;
+}
+
+// Jagged star shaped ring, like a coastline
+inline vector<Vector2> benchmarkRing(size_t vertices, mt19937& rng)
+{
+	uniform_real_distribution<float> radius(60.0f, 100.0f);
+
+	vector<Vector2> ring(vertices);
+	for(size_t i = 0; i < vertices; ++i)
+	{
+		float angle = 2.0f * PI * (float)i / (float)vertices;
+		float r = radius(rng);
+		ring[i] = { cosf(angle) * r, sinf(angle) * r };
+	}
+	return ring;
+}
+
+// ringContains (the getProvinceAt loop) against the packed SoA kernel
+inline void benchmarkPointInRing()
+{
+	mt19937 rng(42);
+	uniform_real_distribution<float> coordinate(-110.0f, 110.0f);
+
+	const size_t point_count = 4096;
+	vector<Vector2> points(point_count);
+	for(auto& p : points) p = { coordinate(rng), coordinate(rng) };
+
+	printf("Point in ring, %s kernel (%d edges per iteration)\n", RING_KERNEL_NAME, RING_KERNEL_WIDTH);
+	printf("%10s %14s %14s %14s %9s %10s\n", "vertices", "loop ns/test", "scalar ns/test", "kernel ns/test", "speedup", "mismatches");
+
+	for(size_t vertices : { 8, 32, 128, 1024, 8192 })
+	{
+		vector<Vector2> ring = benchmarkRing(vertices, rng);
+
+		vector<float> xs, ys;
+		xs.push_back(ring.back().x);
+		ys.push_back(ring.back().y);
+		for(const auto& p : ring)
+		{
+			xs.push_back(p.x);
+			ys.push_back(p.y);
+		}
+
+		double loop = benchmarkNanoseconds(point_count, [&]
+		{
+			uint32_t inside = 0;
+			for(const auto& p : points) inside += ringContains(ring, p);
+			benchmark_sink = inside;
+		});
+
+		double scalar = benchmarkNanoseconds(point_count, [&]
+		{
+			uint32_t inside = 0;
+			for(const auto& p : points) inside += ringCrossingsScalar(xs.data(), ys.data(), 0, vertices, p.x, p.y) & 1;
+			benchmark_sink = inside;
+		});
+
+		double kernel = benchmarkNanoseconds(point_count, [&]
+		{
+			uint32_t inside = 0;
+			for(const auto& p : points) inside += ringContainsPacked(xs.data(), ys.data(), vertices, p);
+			benchmark_sink = inside;
+		});
+
+		size_t mismatches = 0;
+		for(const auto& p : points)
+		{
+			if(ringContains(ring, p) != ringContainsPacked(xs.data(), ys.data(), vertices, p)) mismatches++;
+		}
+
+		printf("%10zu %14.1f %14.1f %14.1f %8.2fx %10zu\n", vertices, loop, scalar, kernel, loop / kernel, mismatches);
+	}
+}
+
+// Economy ticks per second on synthetic maps: the scalar loop and the vector kernel on one thread, then the
+// full update (kernel plus per country reduction) on the job system
+inline void benchmarkEconomy()
+{
+	mt19937 rng(7);
+	uniform_int_distribution<int> category(0, 4);
+
+	JobSystem jobs;
+	const float hours = 1.0f;
+
+	printf("\nEconomy tick, %s kernel (job system threads: %u)\n", ECONOMY_KERNEL_NAME, jobs.getThreadCount());
+	printf("%10s %14s %14s %14s %12s\n", "provinces", "scalar tick/s", "kernel tick/s", "update tick/s", "max diff");
+
+	for(size_t count : { 10000, 100000 })
+	{
+		// NUTS style categories (0 = no data), a thousand countries of neighbouring provinces
+		vector<Province> provinces(count);
+		vector<CountryId> owners(count);
+		for(size_t i = 0; i < count; ++i)
+		{
+			provinces[i].urban_type = (float)category(rng);
+			provinces[i].mountain_type = (float)category(rng);
+			provinces[i].coast_type = (float)category(rng);
+			owners[i] = (CountryId)(i * 1000 / count);
+		}
+
+		vector<float> urban(count), rugged(count), coastal(count);
+		for(size_t i = 0; i < count; ++i)
+		{
+			urban[i] = Economy::attributeLevel(provinces[i].urban_type);
+			rugged[i] = Economy::attributeLevel(provinces[i].mountain_type);
+			coastal[i] = Economy::attributeLevel(provinces[i].coast_type);
+		}
+
+		vector<float> production(count), consumption(count), scalar_stockpile(count, 0.0f), kernel_stockpile(count, 0.0f);
+		EconomyColumns scalar_columns = { urban.data(), rugged.data(), coastal.data(), production.data(), consumption.data(), scalar_stockpile.data() };
+		EconomyColumns kernel_columns = { urban.data(), rugged.data(), coastal.data(), production.data(), consumption.data(), kernel_stockpile.data() };
+
+		double scalar = benchmarkNanoseconds(1, [&] { economyKernelScalar(scalar_columns, 0, count, hours); });
+		double kernel = benchmarkNanoseconds(1, [&] { economyKernel(kernel_columns, 0, count, hours); });
+
+		// Both ran the same number of ticks, so the stockpiles should agree
+		float max_diff = 0.0f;
+		for(size_t i = 0; i < count; ++i) max_diff = max(max_diff, fabsf(scalar_stockpile[i] - kernel_stockpile[i]));
+
+		Economy economy;
+		economy.build(provinces, owners);
+		double parallel = benchmarkNanoseconds(1, [&] { economy.update(hours, jobs); });
+		benchmark_sink = (uint32_t)economy.getCountryTotals()[0].stockpile;
+
+		printf("%10zu %14.0f %14.0f %14.0f %12g\n", count, 1e9 / scalar, 1e9 / kernel, 1e9 / parallel, max_diff);
+	}
+}
+
+// Synthetic map for the query benchmark: a side x side grid of jagged provinces, every seventh with a small island
+inline vector<Province> benchmarkProvinces(size_t side, float cell, mt19937& rng)
+{
+	vector<Province> provinces(side * side);
+
+	for(size_t i = 0; i < provinces.size(); ++i)
+	{
+		Province& province = provinces[i];
+		Vector2 centre = { ((float)(i % side) + 0.5f) * cell, ((float)(i / side) + 0.5f) * cell };
+
+		// benchmarkRing spans up to 100 units, scale it into the cell
+		vector<Vector2> ring = benchmarkRing(24, rng);
+		for(auto& p : ring) p = { centre.x + p.x * cell * 0.0048f, centre.y + p.y * cell * 0.0048f };
+		province.polygons.push_back(ring);
+
+		if(i % 7 == 0)
+		{
+			vector<Vector2> island = benchmarkRing(8, rng);
+			for(auto& p : island) p = { centre.x + cell * 0.4f + p.x * cell * 0.0008f, centre.y - cell * 0.4f + p.y * cell * 0.0008f };
+			province.polygons.push_back(island);
+		}
+
+		for(const auto& polygon : province.polygons)
+		{
+			float minX = polygon[0].x, minY = polygon[0].y, maxX = minX, maxY = minY;
+			for(const auto& p : polygon)
+			{
+				minX = min(minX, p.x); minY = min(minY, p.y);
+				maxX = max(maxX, p.x); maxY = max(maxY, p.y);
+			}
+			province.polygon_bounds.push_back({ minX, minY, maxX - minX, maxY - minY });
+		}
+
+		province.interior_point = centre;
+	}
+
+	return provinces;
+}
+
+// Closest ring distance of a province, the brute force side of the query checks
+inline float benchmarkProvinceDistanceSq(const Province& province, Vector2 point)
+{
+	float best = 1e30f;
+	for(const auto& polygon : province.polygons) best = min(best, ringDistanceSq(polygon, point));
+	return best;
+}
+
+// ProvinceQueries (grid backed) against a scan over every province, which is what they must agree with
+inline void benchmarkProvinceQueries()
+{
+	mt19937 rng(11);
+
+	const size_t side = 120;
+	const float cell = 10.0f;
+	const float extent = side * cell;
+
+	vector<Province> provinces = benchmarkProvinces(side, cell, rng);
+
+	SpatialGrid grid;
+	grid.build(provinces);
+	PackedRings rings;
+	rings.build(provinces);
+	PickRaster raster;	// Not built, so points go through the grid
+	JobSystem jobs;
+
+	ProvinceQueries queries;
+	queries.init(&provinces, &grid, &rings, &raster, nullptr, &jobs);
+
+	uniform_real_distribution<float> coordinate(-cell, extent + cell);
+	uniform_real_distribution<float> size(cell, cell * 12.0f);
+
+	const size_t query_count = 256;
+	vector<Vector2> centres(query_count);
+	vector<float> radii(query_count);
+	vector<vector<Vector2>> lassos(query_count);
+	for(size_t i = 0; i < query_count; ++i)
+	{
+		centres[i] = { coordinate(rng), coordinate(rng) };
+		radii[i] = size(rng);
+
+		lassos[i] = benchmarkRing(16, rng);
+		for(auto& p : lassos[i]) p = { centres[i].x + p.x * radii[i] * 0.01f, centres[i].y + p.y * radii[i] * 0.01f };
+	}
+
+	const size_t point_count = 16384;
+	vector<Vector2> points(point_count);
+	for(auto& p : points) p = { coordinate(rng), coordinate(rng) };
+
+	auto bruteQueryPoint = [&](Vector2 point)
+	{
+		for(ProvinceHandle handle = 0; handle < provinces.size(); ++handle)
+		{
+			for(const auto& polygon : provinces[handle].polygons)
+			{
+				if(ringContains(polygon, point)) return handle;
+			}
+		}
+		return INVALID_PROVINCE;
+	};
+
+	auto bruteQueryPolygon = [&](const vector<Vector2>& lasso, vector<ProvinceHandle>& out)
+	{
+		out.clear();
+		for(ProvinceHandle handle = 0; handle < provinces.size(); ++handle)
+		{
+			if(ringContains(lasso, provinces[handle].interior_point)) out.push_back(handle);
+		}
+	};
+
+	auto bruteQueryRadius = [&](Vector2 centre, float radius, vector<ProvinceHandle>& out)
+	{
+		out.clear();
+		for(ProvinceHandle handle = 0; handle < provinces.size(); ++handle)
+		{
+			if(benchmarkProvinceDistanceSq(provinces[handle], centre) <= radius * radius) out.push_back(handle);
+		}
+	};
+
+	// Ties break by handle, same as the partial_sort over (distance, handle) pairs in queryNearest
+	vector<pair<float, ProvinceHandle>> ranked;
+	auto bruteQueryNearest = [&](Vector2 point, size_t k, vector<ProvinceHandle>& out)
+	{
+		ranked.clear();
+		for(ProvinceHandle handle = 0; handle < provinces.size(); ++handle)
+		{
+			ranked.push_back({ benchmarkProvinceDistanceSq(provinces[handle], point), handle });
+		}
+
+		size_t count = min(k, ranked.size());
+		partial_sort(ranked.begin(), ranked.begin() + count, ranked.end());
+
+		out.clear();
+		for(size_t i = 0; i < count; ++i) out.push_back(ranked[i].second);
+	};
+
+	const size_t k = 8;
+	vector<ProvinceHandle> result, expected;
+
+	printf("\nProvince queries, %zu provinces (job system threads: %u)\n", provinces.size(), jobs.getThreadCount());
+	printf("%10s %14s %14s %9s %10s\n", "query", "grid us/query", "scan us/query", "speedup", "mismatches");
+
+	auto report = [](const char* name, double grid_ns, double scan_ns, size_t mismatches)
+	{
+		printf("%10s %14.2f %14.2f %8.1fx %10zu\n", name, grid_ns / 1000.0, scan_ns / 1000.0, scan_ns / grid_ns, mismatches);
+	};
+
+	// Batched points, the grid side goes through the sorted parallel path
+	{
+		vector<ProvinceHandle> batch(point_count), scan(point_count);
+
+		double grid_ns = benchmarkNanoseconds(point_count, [&] { queries.queryPoints(points.data(), point_count, batch.data()); });
+		double scan_ns = benchmarkNanoseconds(point_count, [&] { for(size_t i = 0; i < point_count; ++i) scan[i] = bruteQueryPoint(points[i]); });
+
+		size_t mismatches = 0;
+		for(size_t i = 0; i < point_count; ++i) mismatches += batch[i] != scan[i];
+
+		report("points", grid_ns, scan_ns, mismatches);
+	}
+
+	{
+		double grid_ns = benchmarkNanoseconds(query_count, [&] { for(const auto& lasso : lassos) queries.queryPolygon(lasso, result); });
+		double scan_ns = benchmarkNanoseconds(query_count, [&] { for(const auto& lasso : lassos) bruteQueryPolygon(lasso, expected); });
+
+		size_t mismatches = 0;
+		for(const auto& lasso : lassos)
+		{
+			queries.queryPolygon(lasso, result);
+			bruteQueryPolygon(lasso, expected);
+			mismatches += result != expected;
+		}
+
+		report("polygon", grid_ns, scan_ns, mismatches);
+	}
+
+	{
+		double grid_ns = benchmarkNanoseconds(query_count, [&] { for(size_t i = 0; i < query_count; ++i) queries.queryRadius(centres[i], radii[i], result); });
+		double scan_ns = benchmarkNanoseconds(query_count, [&] { for(size_t i = 0; i < query_count; ++i) bruteQueryRadius(centres[i], radii[i], expected); });
+
+		size_t mismatches = 0;
+		for(size_t i = 0; i < query_count; ++i)
+		{
+			queries.queryRadius(centres[i], radii[i], result);
+			bruteQueryRadius(centres[i], radii[i], expected);
+			mismatches += result != expected;
+		}
+
+		report("radius", grid_ns, scan_ns, mismatches);
+	}
+
+	{
+		double grid_ns = benchmarkNanoseconds(query_count, [&] { for(const auto& p : centres) queries.queryNearest(p, k, result); });
+		double scan_ns = benchmarkNanoseconds(query_count, [&] { for(const auto& p : centres) bruteQueryNearest(p, k, expected); });
+
+		size_t mismatches = 0;
+		for(const auto& p : centres)
+		{
+			queries.queryNearest(p, k, result);
+			bruteQueryNearest(p, k, expected);
+			mismatches += result != expected;
+		}
+
+		report("nearest", grid_ns, scan_ns, mismatches);
+	}
+
+	benchmark_sink = (uint32_t)result.size();
+}
+
+inline int runBenchmarks()
+{
+	benchmarkPointInRing();
+	benchmarkEconomy();
+	benchmarkProvinceQueries();
+	return 0;
+}
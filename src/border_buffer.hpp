@@ -0,0 +1,276 @@
+#pragma once
+
+#include "border_mesh.hpp"
+#include "frame_profiler.hpp"
+#include "rlgl.h"
+#include "raymath.h"
+#include <algorithm>
+#include <iostream>
+
+#define BORDERBUFFER_ERR "LakyStrategy::BorderBuffer::Error: "
+
+// Border segments are quads pushed out to a fixed pixel width in the vertex shader, so the buffer doesn't
+// depend on the zoom. The texture coordinate holds the direction to push each corner in.
+static const char* BORDER_BUFFER_VS = R"(
+#version 330
+
+in vec3 vertexPosition;
+in vec2 vertexTexCoord;
+in vec4 vertexColor;
+
+uniform mat4 mvp;
+uniform float halfWidth;	// World units
+
+out vec4 fragColor;
+
+void main()
+{
+	fragColor = vertexColor;
+	gl_Position = mvp * vec4(vertexPosition.xy + vertexTexCoord * halfWidth, 0.0, 1.0);
+}
+)";
+
+static const char* BORDER_BUFFER_FS = R"(
+#version 330
+
+in vec4 fragColor;
+
+out vec4 finalColor;
+
+void main()
+{
+	finalColor = fragColor;
+}
+)";
+
+// The border mesh resident on the GPU, in the same segment order as BorderMesh so its blocks are vertex ranges.
+// Positions never change after loading, only the colours of re-classified segments are patched in place.
+class BorderBuffer
+{
+	public:
+		static constexpr int VERTICES_PER_SEGMENT = 6;	// Two triangles
+		static constexpr float LINE_WIDTH = 1.0f;		// Pixels
+
+		// CPU side, done at load time
+		void build(const BorderMesh& borders, const Color* kind_colors)
+		{
+			const auto& segments = borders.getSegments();
+
+			positions.resize(segments.size() * VERTICES_PER_SEGMENT);
+			offsets.resize(segments.size() * VERTICES_PER_SEGMENT);
+			colors.resize(segments.size() * VERTICES_PER_SEGMENT);
+
+			for(size_t i = 0; i < segments.size(); ++i)
+			{
+				const BorderSegment& segment = segments[i];
+
+				Vector2 d = { segment.b.x - segment.a.x, segment.b.y - segment.a.y };
+				float length = sqrtf(d.x * d.x + d.y * d.y);
+				if(length > 0.0f) d = { d.x / length, d.y / length };
+				Vector2 n = { -d.y, d.x };
+
+				// Corners pushed along the segment as well, so neighbouring segments overlap at their joints
+				Vector2 corner_positions[4] = { segment.a, segment.a, segment.b, segment.b };
+				Vector2 corner_offsets[4] = {
+					{ -d.x + n.x, -d.y + n.y },
+					{ -d.x - n.x, -d.y - n.y },
+					{ d.x + n.x, d.y + n.y },
+					{ d.x - n.x, d.y - n.y }
+				};
+
+				static const int CORNERS[VERTICES_PER_SEGMENT] = { 0, 1, 2, 2, 1, 3 };
+				for(int v = 0; v < VERTICES_PER_SEGMENT; ++v)
+				{
+					positions[i * VERTICES_PER_SEGMENT + v] = corner_positions[CORNERS[v]];
+					offsets[i * VERTICES_PER_SEGMENT + v] = corner_offsets[CORNERS[v]];
+				}
+
+				writeColor(i, kind_colors[segment.kind]);
+			}
+		}
+
+		// GPU side, needs the GL context
+		void upload()
+		{
+			uploaded = true;
+			if(positions.empty()) return;
+
+			shader = LoadShaderFromMemory(BORDER_BUFFER_VS, BORDER_BUFFER_FS);
+			if(shader.id == 0 || shader.id == rlGetShaderIdDefault())
+			{
+				cerr << BORDERBUFFER_ERR << "Failed to compile the border shader, borders are drawn as immediate lines" << endl;
+				return;
+			}
+
+			mvp_loc = GetShaderLocation(shader, "mvp");
+			half_width_loc = GetShaderLocation(shader, "halfWidth");
+
+			vao = rlLoadVertexArray();
+			rlEnableVertexArray(vao);
+
+			position_vbo = rlLoadVertexBuffer(positions.data(), (int)(positions.size() * sizeof(Vector2)), false);
+			rlSetVertexAttribute(RL_DEFAULT_SHADER_ATTRIB_LOCATION_POSITION, 2, RL_FLOAT, false, 0, 0);
+			rlEnableVertexAttribute(RL_DEFAULT_SHADER_ATTRIB_LOCATION_POSITION);
+
+			offset_vbo = rlLoadVertexBuffer(offsets.data(), (int)(offsets.size() * sizeof(Vector2)), false);
+			rlSetVertexAttribute(RL_DEFAULT_SHADER_ATTRIB_LOCATION_TEXCOORD, 2, RL_FLOAT, false, 0, 0);
+			rlEnableVertexAttribute(RL_DEFAULT_SHADER_ATTRIB_LOCATION_TEXCOORD);
+
+			color_vbo = rlLoadVertexBuffer(colors.data(), (int)(colors.size() * sizeof(Color)), true);
+			rlSetVertexAttribute(RL_DEFAULT_SHADER_ATTRIB_LOCATION_COLOR, 4, RL_UNSIGNED_BYTE, true, 0, 0);
+			rlEnableVertexAttribute(RL_DEFAULT_SHADER_ATTRIB_LOCATION_COLOR);
+
+			rlDisableVertexArray();
+
+			// Anything patched before the upload is already in there
+			dirty.clear();
+			ready = true;
+		}
+
+		// Must be called while the GL context is still alive
+		void unload()
+		{
+			if(!uploaded) return;
+
+			if(ready)
+			{
+				rlUnloadVertexArray(vao);
+				rlUnloadVertexBuffer(position_vbo);
+				rlUnloadVertexBuffer(offset_vbo);
+				rlUnloadVertexBuffer(color_vbo);
+			}
+			if(shader.id != 0) UnloadShader(shader);
+
+			shader = {};
+			ready = false;
+			uploaded = false;
+		}
+
+		bool isUploaded() const { return uploaded; }
+
+		// False if the shader or buffers are missing, the caller draws immediate lines instead
+		bool isReady() const { return ready; }
+
+		// Re-colours segments whose kind changed, uploaded by the next flush
+		void patch(const vector<uint32_t>& changed, const BorderMesh& borders, const Color* kind_colors)
+		{
+			const auto& segments = borders.getSegments();
+			for(uint32_t index : changed)
+			{
+				writeColor(index, kind_colors[segments[index].kind]);
+				dirty.push_back(index);
+			}
+		}
+
+		// After a border colour changed, every segment of that kind is rewritten
+		void recolor(const BorderMesh& borders, const Color* kind_colors)
+		{
+			const auto& segments = borders.getSegments();
+			for(size_t i = 0; i < segments.size(); ++i) writeColor(i, kind_colors[segments[i].kind]);
+
+			dirty.clear();
+			if(ready) rlUpdateVertexBuffer(color_vbo, colors.data(), (int)(colors.size() * sizeof(Color)), 0);
+		}
+
+		// Uploads the patched colours, one sub-buffer update per run of neighbouring segments.
+		// Returns the number of updates.
+		uint32_t flush()
+		{
+			if(!ready || dirty.empty()) return 0;
+
+			sort(dirty.begin(), dirty.end());
+			dirty.erase(unique(dirty.begin(), dirty.end()), dirty.end());
+
+			uint32_t updates = 0;
+			for(size_t first = 0; first < dirty.size();)
+			{
+				// Small gaps are cheaper to upload again than to split the update for
+				size_t last = first + 1;
+				while(last < dirty.size() && dirty[last] - dirty[last - 1] <= MERGE_GAP) last++;
+
+				size_t vertex = (size_t)dirty[first] * VERTICES_PER_SEGMENT;
+				size_t count = (size_t)(dirty[last - 1] - dirty[first] + 1) * VERTICES_PER_SEGMENT;
+				rlUpdateVertexBuffer(color_vbo, &colors[vertex], (int)(count * sizeof(Color)), (int)(vertex * sizeof(Color)));
+
+				updates++;
+				first = last;
+			}
+
+			dirty.clear();
+			return updates;
+		}
+
+		// Draws the blocks that intersect the area, consecutive visible blocks in one call (inside BeginMode2D)
+		void draw(const BorderMesh& borders, const Rectangle& area, float zoom, FrameProfiler* profiler = nullptr)
+		{
+			if(!ready) return;
+
+			// Whatever is waiting in the immediate batch belongs under the borders
+			rlDrawRenderBatchActive();
+
+			Matrix mvp = MatrixMultiply(MatrixMultiply(rlGetMatrixTransform(), rlGetMatrixModelview()), rlGetMatrixProjection());
+			float half_width = LINE_WIDTH * 0.5f / max(zoom, 1e-6f);
+
+			rlEnableShader(shader.id);
+			rlSetUniformMatrix(mvp_loc, mvp);
+			rlSetUniform(half_width_loc, &half_width, RL_SHADER_UNIFORM_FLOAT, 1);
+
+			// Both windings show up depending on the segment direction
+			rlDisableBackfaceCulling();
+			rlEnableVertexArray(vao);
+
+			uint32_t vertices = 0, calls = 0;
+			const auto& blocks = borders.getBlocks();
+
+			for(size_t b = 0; b < blocks.size();)
+			{
+				if(!CheckCollisionRecs(blocks[b].bounds, area))
+				{
+					b++;
+					continue;
+				}
+
+				// Blocks are stored in segment order, so a run of visible ones is one vertex range
+				uint32_t first = blocks[b].first;
+				uint32_t count = 0;
+				for(; b < blocks.size() && CheckCollisionRecs(blocks[b].bounds, area); ++b) count += blocks[b].count;
+
+				rlDrawVertexArray((int)first * VERTICES_PER_SEGMENT, (int)count * VERTICES_PER_SEGMENT);
+				vertices += count * VERTICES_PER_SEGMENT;
+				calls++;
+			}
+
+			rlDisableVertexArray();
+			rlEnableBackfaceCulling();
+			rlDisableShader();
+
+			if(profiler && calls > 0) profiler->addDraw(vertices / 3, vertices, calls - 1);
+		}
+
+	private:
+		static constexpr uint32_t MERGE_GAP = 64;	// Segments
+
+		vector<Vector2> positions;	// Segment end point per vertex
+		vector<Vector2> offsets;	// Direction to push the vertex in, scaled by the half width
+		vector<Color> colors;
+
+		vector<uint32_t> dirty;		// Segments patched since the last flush
+
+		Shader shader = {};
+		int mvp_loc = -1;
+		int half_width_loc = -1;
+
+		unsigned int vao = 0;
+		unsigned int position_vbo = 0;
+		unsigned int offset_vbo = 0;
+		unsigned int color_vbo = 0;
+
+		bool uploaded = false;
+		bool ready = false;
+
+		void writeColor(size_t segment, const Color& color)
+		{
+			Color* vertex = &colors[segment * VERTICES_PER_SEGMENT];
+			for(int v = 0; v < VERTICES_PER_SEGMENT; ++v) vertex[v] = color;
+		}
+};
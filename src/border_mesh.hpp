@@ -0,0 +1,293 @@
+#pragma once
+
+#include "province.hpp"
+#include "geometry.hpp"
+#include "ownership.hpp"
+#include <unordered_map>
+#include <algorithm>
+#include <iostream>
+#include <cmath>
+
+// What a border segment separates, so every kind can get its own style without extra geometry
+enum BorderKind : uint8_t
+{
+	BORDER_COAST = 0,	// Only one province has this edge (coastline / edge of the map data)
+	BORDER_PROVINCE,	// Two provinces of the same country
+	BORDER_COUNTRY,		// Two provinces of different countries
+
+	BORDER_KIND_COUNT
+};
+
+struct BorderSegment
+{
+	Vector2 a, b;
+
+	ProvinceHandle left;	// Province whose ring emitted the edge first (a -> b follows its winding)
+	ProvinceHandle right;	// Province on the other side, INVALID_PROVINCE if there is none
+
+	BorderKind kind;
+};
+
+// A run of consecutive, spatially close segments with shared bounds, used for culling
+struct BorderBlock
+{
+	uint32_t first;
+	uint32_t count;
+	Rectangle bounds;
+};
+
+// Indices of the segments around one province
+struct SegmentRange
+{
+	const uint32_t* first;
+	const uint32_t* last;
+
+	const uint32_t* begin() const { return first; }
+	const uint32_t* end() const { return last; }
+	size_t size() const { return last - first; }
+};
+
+// Every edge of every province ring, with the edges shared by two neighbouring provinces stored only once
+class BorderMesh
+{
+	public:
+		// Vertices closer than this (in world units) are treated as the same vertex
+		static constexpr float QUANTUM = 1.0f / 4096.0f;
+
+		// Segments per culling block, 2 vertices each so a block always fits in one rlgl batch
+		static constexpr uint32_t BLOCK_SIZE = 1024;
+
+		void build(const vector<Province>& provinces, const vector<CountryId>& owners)
+		{
+			segments.clear();
+			blocks.clear();
+			province_offsets.clear();
+			province_segments.clear();
+			shared_count = 0;
+
+			size_t edge_count = 0;
+			for(const auto& province : provinces)
+			{
+				for(const auto& ring : province.polygons) edge_count += ring.size();
+			}
+
+			unordered_map<EdgeKey, uint32_t, EdgeKeyHash> edge_lookup;
+			edge_lookup.reserve(edge_count);
+			segments.reserve(edge_count);
+
+			for(ProvinceHandle handle = 0; handle < provinces.size(); ++handle)
+			{
+				for(const auto& ring : provinces[handle].polygons)
+				{
+					if(ring.size() < 2) continue;
+
+					for(size_t i = 0; i < ring.size(); ++i)
+					{
+						const Vector2& a = ring[i];
+						const Vector2& b = ring[(i + 1) % ring.size()];
+
+						uint64_t key_a = quantize(a);
+						uint64_t key_b = quantize(b);
+
+						// Degenerate edge (repeated vertex)
+						if(key_a == key_b) continue;
+
+						EdgeKey key = key_a < key_b ? EdgeKey{key_a, key_b} : EdgeKey{key_b, key_a};
+
+						auto inserted = edge_lookup.try_emplace(key, (uint32_t)segments.size());
+						if(inserted.second)
+						{
+							segments.push_back({a, b, handle, INVALID_PROVINCE, BORDER_COAST});
+							continue;
+						}
+
+						// Seen before: if it came from another province this is a shared border.
+						// Edges repeated inside the same province or touched by a third one are dropped.
+						BorderSegment& segment = segments[inserted.first->second];
+						if(segment.left != handle && segment.right == INVALID_PROVINCE)
+						{
+							segment.right = handle;
+							shared_count++;
+						}
+					}
+				}
+			}
+
+			segments.shrink_to_fit();
+
+			classify(owners);
+			buildBlocks();
+			buildProvinceIndex(provinces.size());
+			segment_dirty.assign(segments.size(), 0);
+			dirty_segments.clear();
+
+			cout << "Built border mesh: " << segments.size() << " segments (" << shared_count << " shared, " << (edge_count - segments.size()) << " duplicate edges removed)" << endl;
+		}
+
+		// Re-derive the kind of every segment from the current owners
+		void classify(const vector<CountryId>& owners)
+		{
+			for(auto& segment : segments)
+			{
+				segment.kind = classifySegment(segment, owners);
+			}
+		}
+
+		// The province changed owner, its segments get re-classified by the next classifyDirty
+		void markProvinceDirty(ProvinceHandle handle)
+		{
+			for(uint32_t index : getProvinceSegments(handle))
+			{
+				if(segment_dirty[index]) continue;
+
+				segment_dirty[index] = 1;
+				dirty_segments.push_back(index);
+			}
+		}
+
+		// Re-derives only the marked segments, returns how many changed kind (and lists them if asked to)
+		size_t classifyDirty(const vector<CountryId>& owners, vector<uint32_t>* changed_segments = nullptr)
+		{
+			size_t changed = 0;
+			for(uint32_t index : dirty_segments)
+			{
+				BorderKind kind = classifySegment(segments[index], owners);
+				if(kind != segments[index].kind)
+				{
+					changed++;
+					if(changed_segments) changed_segments->push_back(index);
+				}
+
+				segments[index].kind = kind;
+				segment_dirty[index] = 0;
+			}
+
+			dirty_segments.clear();
+			return changed;
+		}
+
+		bool hasDirtySegments() const { return !dirty_segments.empty(); }
+
+		SegmentRange getProvinceSegments(ProvinceHandle handle) const
+		{
+			return { province_segments.data() + province_offsets[handle], province_segments.data() + province_offsets[handle + 1] };
+		}
+
+		static BorderKind classifySegment(const BorderSegment& segment, const vector<CountryId>& owners)
+		{
+			if(segment.right == INVALID_PROVINCE) return BORDER_COAST;
+
+			if(owners[segment.left] == owners[segment.right])
+			{
+				return BORDER_PROVINCE;
+			}
+
+			return BORDER_COUNTRY;
+		}
+
+		const vector<BorderSegment>& getSegments() const { return segments; }
+		const vector<BorderBlock>& getBlocks() const { return blocks; }
+		size_t getSharedCount() const { return shared_count; }
+
+		static uint64_t quantize(const Vector2& p)
+		{
+			int32_t qx = (int32_t)lroundf(p.x / QUANTUM);
+			int32_t qy = (int32_t)lroundf(p.y / QUANTUM);
+			return ((uint64_t)(uint32_t)qx << 32) | (uint64_t)(uint32_t)qy;
+		}
+
+	private:
+		struct EdgeKey
+		{
+			uint64_t a, b;
+			bool operator==(const EdgeKey& other) const { return a == other.a && b == other.b; }
+		};
+
+		struct EdgeKeyHash
+		{
+			size_t operator()(const EdgeKey& key) const
+			{
+				uint64_t h = key.a * 0x9E3779B97F4A7C15ull;
+				h ^= key.b + 0x9E3779B97F4A7C15ull + (h << 6) + (h >> 2);
+				return (size_t)h;
+			}
+		};
+
+		vector<BorderSegment> segments;
+		vector<BorderBlock> blocks;
+		size_t shared_count = 0;
+
+		// Segments touching each province, CSR layout (province_offsets has one extra entry at the end)
+		vector<uint32_t> province_offsets;
+		vector<uint32_t> province_segments;
+
+		// Segments waiting for classifyDirty, flagged so each is listed once
+		vector<uint8_t> segment_dirty;
+		vector<uint32_t> dirty_segments;
+
+		void buildProvinceIndex(size_t province_count)
+		{
+			province_offsets.assign(province_count + 1, 0);
+
+			for(const auto& segment : segments)
+			{
+				province_offsets[segment.left + 1]++;
+				if(segment.right != INVALID_PROVINCE) province_offsets[segment.right + 1]++;
+			}
+
+			for(size_t i = 0; i < province_count; ++i) province_offsets[i + 1] += province_offsets[i];
+
+			province_segments.resize(province_offsets.back());
+			vector<uint32_t> cursor(province_offsets.begin(), province_offsets.end() - 1);
+
+			for(uint32_t i = 0; i < segments.size(); ++i)
+			{
+				province_segments[cursor[segments[i].left]++] = i;
+				if(segments[i].right != INVALID_PROVINCE) province_segments[cursor[segments[i].right]++] = i;
+			}
+		}
+
+		// Reorders the segments into spatially compact blocks
+		void buildBlocks()
+		{
+			if(segments.empty()) return;
+
+			vector<uint32_t> order(segments.size());
+			vector<Vector2> centres(segments.size());
+			vector<uint32_t> weights(segments.size(), 1);
+
+			for(uint32_t i = 0; i < segments.size(); ++i)
+			{
+				order[i] = i;
+				centres[i] = { (segments[i].a.x + segments[i].b.x) / 2, (segments[i].a.y + segments[i].b.y) / 2 };
+			}
+
+			vector<pair<size_t, size_t>> groups;
+			partitionByMedian(order, 0, order.size(), centres, weights, BLOCK_SIZE, groups);
+
+			vector<BorderSegment> sorted;
+			sorted.reserve(segments.size());
+			for(uint32_t index : order) sorted.push_back(segments[index]);
+			segments.swap(sorted);
+
+			for(const auto& group : groups)
+			{
+				uint32_t first = (uint32_t)group.first;
+				uint32_t count = (uint32_t)(group.second - group.first);
+
+				float minX = segments[first].a.x, minY = segments[first].a.y;
+				float maxX = minX, maxY = minY;
+
+				for(uint32_t i = first; i < first + count; ++i)
+				{
+					const BorderSegment& s = segments[i];
+					minX = min(minX, min(s.a.x, s.b.x));
+					minY = min(minY, min(s.a.y, s.b.y));
+					maxX = max(maxX, max(s.a.x, s.b.x));
+					maxY = max(maxY, max(s.a.y, s.b.y));
+				}
+
+				blocks.push_back({first, count, {minX, minY, maxX - minX, maxY - minY}});
+			}
+		}
+};
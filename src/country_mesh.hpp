@@ -0,0 +1,442 @@
+#pragma once
+
+#include "province.hpp"
+#include "border_mesh.hpp"
+#include "ownership.hpp"
+#include "geometry.hpp"
+#include "earcut.hpp"
+#include "frame_profiler.hpp"
+#include "rlgl.h"
+#include <algorithm>
+#include <array>
+
+// One country drawn as a single dissolved shape instead of its provinces
+struct CountryMesh
+{
+	CountryId country;
+	Color color;
+
+	vector<ProvinceHandle> members;
+
+	vector<Vector2> triangles;	// Fill, triangle list
+	vector<Vector2> outline;	// Outline, line list
+	Rectangle bounds;
+
+	bool dissolved;				// False if the outline didn't close and the province fills are used instead
+	bool dirty;
+};
+
+// Per country fill and outline meshes used at strategic zoom levels
+class CountryMeshes
+{
+	public:
+		static constexpr float ZOOM_THRESHOLD = 0.5f;		// Used below this zoom
+		static constexpr float SIMPLIFY_TOLERANCE = 0.75f;	// World units, well under a pixel at the threshold
+		static constexpr size_t BATCH_PIECE = RL_DEFAULT_BATCH_BUFFER_ELEMENTS / 3 * 3;
+
+		void build(const vector<Province>& provinces, const BorderMesh& borders, const Ownership& ownership)
+		{
+			meshes.clear();
+
+			for(CountryId id = 0; id < ownership.getCountryCount(); ++id)
+			{
+				getOrCreate(id).color = ownership.getCountry(id).color;
+			}
+
+			const vector<CountryId>& owners = ownership.getOwners();
+			for(ProvinceHandle handle = 0; handle < provinces.size(); ++handle)
+			{
+				getOrCreate(owners[handle]).members.push_back(handle);
+			}
+
+			size_t dissolved_count = 0;
+			for(auto& mesh : meshes)
+			{
+				rebuild(mesh, provinces, borders, owners);
+				if(mesh.dissolved) dissolved_count++;
+			}
+
+			cout << "Built country meshes: " << meshes.size() << " countries (" << dissolved_count << " dissolved)" << endl;
+		}
+
+		// A province moved from one country to another, only those two meshes are rebuilt (lazily)
+		void moveProvince(ProvinceHandle handle, CountryId from, CountryId to)
+		{
+			CountryMesh& old_mesh = getOrCreate(from);
+			old_mesh.members.erase(remove(old_mesh.members.begin(), old_mesh.members.end(), handle), old_mesh.members.end());
+			old_mesh.dirty = true;
+
+			CountryMesh& new_mesh = getOrCreate(to);
+			new_mesh.members.push_back(handle);
+			new_mesh.dirty = true;
+		}
+
+		void setCountryColor(CountryId id, const Color& color) { getOrCreate(id).color = color; }
+
+		// Returns true if anything was rebuilt. The border kinds have to be up to date.
+		bool rebuildDirty(const vector<Province>& provinces, const BorderMesh& borders, const vector<CountryId>& owners)
+		{
+			bool rebuilt = false;
+			for(auto& mesh : meshes)
+			{
+				if(!mesh.dirty) continue;
+
+				rebuild(mesh, provinces, borders, owners);
+				rebuilt = true;
+			}
+			return rebuilt;
+		}
+
+		void render(const Rectangle& area, const Color& outline_color, FrameProfiler* profiler = nullptr)
+		{
+			uint32_t vertices = 0, flushes = 0;
+
+			rlBegin(RL_TRIANGLES);
+			for(const auto& mesh : meshes)
+			{
+				if(mesh.members.empty() || !CheckCollisionRecs(mesh.bounds, area)) continue;
+
+				rlColor4ub(mesh.color.r, mesh.color.g, mesh.color.b, mesh.color.a);
+
+				// Submit in batch sized pieces so flushes only happen between them
+				for(size_t first = 0; first < mesh.triangles.size(); first += BATCH_PIECE)
+				{
+					size_t last = min(first + BATCH_PIECE, mesh.triangles.size());
+					if(rlCheckRenderBatchLimit((int)(last - first))) flushes++;
+
+					for(size_t v = first; v < last; ++v) rlVertex2f(mesh.triangles[v].x, mesh.triangles[v].y);
+				}
+				vertices += (uint32_t)mesh.triangles.size();
+			}
+			rlEnd();
+
+			if(profiler) profiler->addDraw(vertices / 3, vertices, flushes);
+
+			rlBegin(RL_LINES);
+			rlColor4ub(outline_color.r, outline_color.g, outline_color.b, outline_color.a);
+			for(const auto& mesh : meshes)
+			{
+				if(mesh.members.empty() || !CheckCollisionRecs(mesh.bounds, area)) continue;
+
+				for(const auto& v : mesh.outline) rlVertex2f(v.x, v.y);
+			}
+			rlEnd();
+		}
+
+		const vector<CountryMesh>& getMeshes() const { return meshes; }
+
+	private:
+		vector<CountryMesh> meshes;		// Indexed by CountryId
+
+		// A boundary edge of the country, oriented so the country is on the same side for all of them
+		struct DirectedEdge
+		{
+			Vector2 a, b;
+			uint64_t key_a, key_b;
+			ProvinceHandle outside;		// Province on the other side (INVALID_PROVINCE for coast)
+			bool used;
+		};
+
+		CountryMesh& getOrCreate(CountryId id)
+		{
+			while(meshes.size() <= id)
+			{
+				CountryMesh mesh;
+				mesh.country = (CountryId)meshes.size();
+				mesh.color = WHITE;
+				mesh.bounds = {0, 0, 0, 0};
+				mesh.dissolved = false;
+				mesh.dirty = true;
+				meshes.push_back(mesh);
+			}
+
+			return meshes[id];
+		}
+
+		void rebuild(CountryMesh& mesh, const vector<Province>& provinces, const BorderMesh& borders, const vector<CountryId>& owners)
+		{
+			mesh.triangles.clear();
+			mesh.outline.clear();
+			mesh.dirty = false;
+			mesh.dissolved = false;
+
+			if(mesh.members.empty()) return;
+
+			// Collect every segment that has this country on exactly one side
+			vector<DirectedEdge> edges;
+			const auto& segments = borders.getSegments();
+
+			for(ProvinceHandle handle : mesh.members)
+			{
+				for(uint32_t index : borders.getProvinceSegments(handle))
+				{
+					const BorderSegment& segment = segments[index];
+					if(segment.kind == BORDER_PROVINCE) continue;
+
+					bool left_inside = owners[segment.left] == mesh.country;
+					bool right_inside = segment.right != INVALID_PROVINCE && owners[segment.right] == mesh.country;
+
+					if(left_inside == right_inside) continue;
+
+					// Keep the inside province's winding
+					if(left_inside) edges.push_back({segment.a, segment.b, 0, 0, segment.right, false});
+					else edges.push_back({segment.b, segment.a, 0, 0, segment.left, false});
+				}
+			}
+
+			for(auto& edge : edges)
+			{
+				edge.key_a = BorderMesh::quantize(edge.a);
+				edge.key_b = BorderMesh::quantize(edge.b);
+			}
+
+			vector<vector<Vector2>> rings;
+			mesh.dissolved = chainRings(edges, owners, rings);
+
+			if(mesh.dissolved)
+			{
+				mesh.dissolved = triangulateRings(rings, mesh.triangles);
+			}
+
+			if(mesh.dissolved)
+			{
+				for(const auto& ring : rings)
+				{
+					for(size_t i = 0; i < ring.size(); ++i)
+					{
+						mesh.outline.push_back(ring[i]);
+						mesh.outline.push_back(ring[(i + 1) % ring.size()]);
+					}
+				}
+			}
+			else
+			{
+				// Couldn't dissolve (gaps between neighbouring rings), use the province fills with the country colour
+				mesh.triangles.clear();
+				for(ProvinceHandle handle : mesh.members) appendProvinceTriangles(provinces[handle], mesh.triangles);
+
+				for(const auto& edge : edges)
+				{
+					mesh.outline.push_back(edge.a);
+					mesh.outline.push_back(edge.b);
+				}
+			}
+
+			mesh.bounds = boundsOf(mesh.triangles);
+		}
+
+		// Links the boundary edges into closed rings and simplifies them.
+		// Returns false if some chain doesn't close.
+		bool chainRings(vector<DirectedEdge>& edges, const vector<CountryId>& owners, vector<vector<Vector2>>& rings)
+		{
+			// Edges sorted by start vertex, so the continuation of a chain is a binary search away
+			vector<uint32_t> by_start(edges.size());
+			for(uint32_t i = 0; i < by_start.size(); ++i) by_start[i] = i;
+			sort(by_start.begin(), by_start.end(), [&](uint32_t a, uint32_t b) { return edges[a].key_a < edges[b].key_a; });
+
+			auto findNext = [&](uint64_t key) -> int
+			{
+				auto it = lower_bound(by_start.begin(), by_start.end(), key, [&](uint32_t index, uint64_t k) { return edges[index].key_a < k; });
+				for(; it != by_start.end() && edges[*it].key_a == key; ++it)
+				{
+					if(!edges[*it].used) return (int)*it;
+				}
+				return -1;
+			};
+
+			for(uint32_t start = 0; start < edges.size(); ++start)
+			{
+				if(edges[start].used) continue;
+
+				vector<Vector2> points;
+				vector<CountryId> neighbours; // Country on the other side of each edge, for simplification runs
+
+				int current = (int)start;
+				while(current >= 0)
+				{
+					DirectedEdge& edge = edges[current];
+					edge.used = true;
+
+					points.push_back(edge.a);
+					neighbours.push_back(edge.outside == INVALID_PROVINCE ? INVALID_COUNTRY : owners[edge.outside]);
+
+					if(edge.key_b == edges[start].key_a) break;
+					current = findNext(edge.key_b);
+				}
+
+				if(current < 0) return false;
+				if(points.size() < 3) continue;
+
+				vector<Vector2> simplified;
+				simplifyRing(points, neighbours, simplified);
+				rings.push_back(move(simplified));
+			}
+
+			return !rings.empty();
+		}
+
+		// Douglas-Peucker per run of edges that border the same neighbour. Runs start and end at the points where
+		// the neighbour changes, so both countries along a border simplify it to the same points.
+		static void simplifyRing(const vector<Vector2>& points, const vector<CountryId>& neighbours, vector<Vector2>& out)
+		{
+			size_t n = points.size();
+
+			// Rotate so the ring starts where the neighbour changes
+			size_t start = 0;
+			for(size_t i = 0; i < n; ++i)
+			{
+				if(neighbours[i] != neighbours[(i + n - 1) % n])
+				{
+					start = i;
+					break;
+				}
+			}
+
+			vector<Vector2> ring(n + 1);
+			vector<CountryId> ring_neighbours(n);
+			for(size_t i = 0; i < n; ++i)
+			{
+				ring[i] = points[(start + i) % n];
+				ring_neighbours[i] = neighbours[(start + i) % n];
+			}
+			ring[n] = ring[0];
+
+			size_t run_start = 0;
+			for(size_t i = 1; i <= n; ++i)
+			{
+				if(i == n || ring_neighbours[i] != ring_neighbours[run_start])
+				{
+					if(run_start == 0 && i == n)
+					{
+						// One neighbour all around (island), pin the point farthest from the start too
+						size_t far = 0;
+						float far_distance = -1.0f;
+						for(size_t k = 1; k < n; ++k)
+						{
+							float dx = ring[k].x - ring[0].x, dy = ring[k].y - ring[0].y;
+							if(dx * dx + dy * dy > far_distance) { far_distance = dx * dx + dy * dy; far = k; }
+						}
+
+						simplifyRun(ring, 0, far, SIMPLIFY_TOLERANCE, out);
+						simplifyRun(ring, far, n, SIMPLIFY_TOLERANCE, out);
+					}
+					else
+					{
+						simplifyRun(ring, run_start, i, SIMPLIFY_TOLERANCE, out);
+					}
+
+					run_start = i;
+				}
+			}
+
+			// Too small to survive simplification, keep it as it was
+			if(out.size() < 3)
+			{
+				out.assign(points.begin(), points.end());
+			}
+		}
+
+		// Rings inside an odd number of other rings are holes of the smallest ring around them
+		static bool triangulateRings(const vector<vector<Vector2>>& rings, vector<Vector2>& triangles)
+		{
+			vector<size_t> order(rings.size());
+			vector<float> areas(rings.size());
+			for(size_t i = 0; i < rings.size(); ++i)
+			{
+				order[i] = i;
+				areas[i] = fabsf(ringSignedArea(rings[i]));
+			}
+			sort(order.begin(), order.end(), [&](size_t a, size_t b) { return areas[a] > areas[b]; });
+
+			// For every ring (by decreasing area), its parent and nesting depth
+			vector<int> parent(rings.size(), -1);
+			vector<int> depth(rings.size(), 0);
+
+			for(size_t oi = 0; oi < order.size(); ++oi)
+			{
+				size_t i = order[oi];
+				for(size_t oj = oi; oj-- > 0;)
+				{
+					size_t j = order[oj];
+					if(ringContains(rings[j], rings[i][0]))
+					{
+						parent[i] = (int)j;
+						depth[i] = depth[j] + 1;
+						break;
+					}
+				}
+			}
+
+			for(size_t i = 0; i < rings.size(); ++i)
+			{
+				if(depth[i] % 2 != 0) continue;
+
+				vector<vector<array<double, 2>>> polygon;
+				vector<Vector2> flat;
+
+				auto addRing = [&](const vector<Vector2>& ring)
+				{
+					polygon.emplace_back();
+					polygon.back().reserve(ring.size());
+					for(const auto& p : ring)
+					{
+						polygon.back().push_back({ (double)p.x, (double)p.y });
+						flat.push_back(p);
+					}
+				};
+
+				addRing(rings[i]);
+				for(size_t h = 0; h < rings.size(); ++h)
+				{
+					if(parent[h] == (int)i && depth[h] % 2 != 0) addRing(rings[h]);
+				}
+
+				vector<uint32_t> indices = mapbox::earcut<uint32_t>(polygon);
+				if(indices.empty()) return false;
+
+				// Same winding as MapEngine::render
+				for(size_t t = 0; t + 2 < indices.size(); t += 3)
+				{
+					triangles.push_back(flat[indices[t]]);
+					triangles.push_back(flat[indices[t + 2]]);
+					triangles.push_back(flat[indices[t + 1]]);
+				}
+			}
+
+			return true;
+		}
+
+		static void appendProvinceTriangles(const Province& province, vector<Vector2>& triangles)
+		{
+			for(size_t poly_index = 0; poly_index < province.polygons.size(); ++poly_index)
+			{
+				const auto& poly = province.polygons[poly_index];
+				const auto& indices = province.polygon_indices[poly_index];
+
+				for(size_t i = 0; i + 2 < indices.size(); i += 3)
+				{
+					uint32_t idxA = indices[i], idxB = indices[i+1], idxC = indices[i+2];
+					if(idxA >= poly.size() || idxB >= poly.size() || idxC >= poly.size()) continue;
+
+					triangles.push_back(poly[idxA]);
+					triangles.push_back(poly[idxC]);
+					triangles.push_back(poly[idxB]);
+				}
+			}
+		}
+
+		static Rectangle boundsOf(const vector<Vector2>& points)
+		{
+			if(points.empty()) return {0, 0, 0, 0};
+
+			float minX = points[0].x, minY = points[0].y, maxX = minX, maxY = minY;
+			for(const auto& p : points)
+			{
+				minX = min(minX, p.x);
+				minY = min(minY, p.y);
+				maxX = max(maxX, p.x);
+				maxY = max(maxY, p.y);
+			}
+			return {minX, minY, maxX - minX, maxY - minY};
+		}
+};
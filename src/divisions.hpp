@@ -0,0 +1,379 @@
+#pragma once
+
+#include "province.hpp"
+#include "ownership.hpp"
+#include "pathfinding.hpp"
+#include "job_system.hpp"
+#include <algorithm>
+
+// Generation in the top bits, slot in the rest, so a stale id of a disbanded division never finds its replacement
+typedef uint32_t DivisionId;
+
+static constexpr DivisionId INVALID_DIVISION = UINT32_MAX;
+
+enum DivisionType : uint8_t
+{
+	DIVISION_INFANTRY = 0,
+	DIVISION_ARMOUR,
+
+	DIVISION_TYPE_COUNT
+};
+
+// What the renderer gets of the divisions each tick, one entry per division in storage order
+struct DivisionSnapshot
+{
+	vector<DivisionId> ids;
+	vector<ProvinceHandle> provinces;
+	vector<ProvinceHandle> next_provinces;	// INVALID_PROVINCE if not moving
+	vector<float> progress;					// Towards the next province, 0..1
+	vector<CountryId> owners;
+	vector<DivisionType> types;
+	vector<float> strength;
+	vector<float> organisation;
+};
+
+// Division components as SoA columns, so every system walks contiguous arrays and can split them into chunks
+// over the job system. Removal swaps the last division into the hole, columns stay dense.
+// Every province keeps an intrusive list of the divisions stationed in it, moving or finding them is O(1).
+class Divisions
+{
+	public:
+		static constexpr size_t CHUNK = 1024;		// Divisions per work item
+
+		static constexpr float BASE_SPEED = 4.0f;				// World units per hour on flat land, for infantry
+		static constexpr float ARMOUR_SPEED = 6.0f;
+		static constexpr float ORGANISATION_RECOVERY = 0.02f;	// Per hour while standing, at full supply
+		static constexpr float ORGANISATION_MARCH_LOSS = 0.005f;	// Per hour while moving
+		static constexpr float SUPPLY_USE = 0.01f;				// Per hour
+		static constexpr float SUPPLY_REFILL = 0.05f;			// Per hour, scaled by the province's supply
+
+		// Forgets every division
+		void init(size_t province_count)
+		{
+			ids.clear(); provinces.clear(); owners.clear(); types.clear();
+			next_provinces.clear(); progress.clear(); step_costs.clear(); speeds.clear();
+			strength.clear(); organisation.clear(); supply.clear();
+			paths.clear(); path_steps.clear();
+			stationed_prev.clear(); stationed_next.clear();
+
+			slot_dense.clear();
+			slot_generation.clear();
+			free_slots.clear();
+
+			stationed_first.assign(province_count, NONE);
+			stationed_count.assign(province_count, 0);
+		}
+
+		DivisionId spawn(ProvinceHandle province, CountryId owner, DivisionType type = DIVISION_INFANTRY)
+		{
+			if(province >= stationed_first.size()) return INVALID_DIVISION;
+
+			uint32_t slot;
+			if(!free_slots.empty())
+			{
+				slot = free_slots.back();
+				free_slots.pop_back();
+			}
+			else
+			{
+				if(slot_dense.size() > SLOT_MASK) return INVALID_DIVISION;
+
+				slot = (uint32_t)slot_dense.size();
+				slot_dense.push_back(NONE);
+				slot_generation.push_back(0);
+			}
+
+			DivisionId id = makeId(slot);
+			uint32_t index = (uint32_t)ids.size();
+			slot_dense[slot] = index;
+
+			ids.push_back(id);
+			provinces.push_back(province);
+			owners.push_back(owner);
+			types.push_back(type);
+			next_provinces.push_back(INVALID_PROVINCE);
+			progress.push_back(0.0f);
+			step_costs.push_back(0.0f);
+			speeds.push_back(type == DIVISION_ARMOUR ? ARMOUR_SPEED : BASE_SPEED);
+			strength.push_back(1.0f);
+			organisation.push_back(1.0f);
+			supply.push_back(1.0f);
+			paths.emplace_back();
+			path_steps.push_back(0);
+			stationed_prev.push_back(NONE);
+			stationed_next.push_back(NONE);
+
+			link(index, province);
+			return id;
+		}
+
+		void disband(DivisionId id)
+		{
+			uint32_t index = indexOf(id);
+			if(index == NONE) return;
+
+			unlink(index, provinces[index]);
+
+			// The last division takes over the hole, its neighbours in the stationed list have to follow it
+			uint32_t last = (uint32_t)ids.size() - 1;
+			if(index != last)
+			{
+				unlink(last, provinces[last]);
+				moveDense(last, index);
+				link(index, provinces[index]);
+			}
+
+			popDense();
+
+			uint32_t slot = id & SLOT_MASK;
+			slot_dense[slot] = NONE;
+
+			// A slot retires instead of wrapping its generation, so stale ids never come back to life
+			// (and the last slot never hands out INVALID_DIVISION)
+			if(++slot_generation[slot] != 0 && makeId(slot) != INVALID_DIVISION) free_slots.push_back(slot);
+		}
+
+		bool isAlive(DivisionId id) const { return indexOf(id) != NONE; }
+		size_t size() const { return ids.size(); }
+
+		ProvinceHandle getProvince(DivisionId id) const
+		{
+			uint32_t index = indexOf(id);
+			return index != NONE ? provinces[index] : INVALID_PROVINCE;
+		}
+
+		CountryId getOwner(DivisionId id) const
+		{
+			uint32_t index = indexOf(id);
+			return index != NONE ? owners[index] : INVALID_COUNTRY;
+		}
+
+		uint32_t getStationedCount(ProvinceHandle province) const { return province < stationed_count.size() ? stationed_count[province] : 0; }
+
+		// Calls fn(DivisionId) for every division in the province
+		template<typename Fn>
+		void forEachStationed(ProvinceHandle province, Fn&& fn) const
+		{
+			if(province >= stationed_first.size()) return;
+
+			for(uint32_t index = stationed_first[province]; index != NONE; index = stationed_next[index]) fn(ids[index]);
+		}
+
+		// Follows the path (from the division's province, as the pathfinder returns it). An empty path stops it.
+		void order(DivisionId id, const Path& path)
+		{
+			uint32_t index = indexOf(id);
+			if(index == NONE) return;
+
+			paths[index] = path.provinces;
+			path_steps[index] = 0;
+			next_provinces[index] = INVALID_PROVINCE;
+			progress[index] = 0.0f;
+
+			if(paths[index].empty() || paths[index].front() != provinces[index]) paths[index].clear();
+		}
+
+		// One step of game time. Each system is one parallel pass over the columns, province changes are
+		// collected per worker and applied afterwards so the stationed lists are only touched on one thread.
+		// province_supply is indexed by province handle, nullptr means full supply everywhere.
+		void update(float hours, const Pathfinder& pathfinder, const float* province_supply, JobSystem& jobs)
+		{
+			if(ids.empty()) return;
+
+			startSteps(pathfinder);
+
+			if(worker_arrivals.size() < jobs.getThreadCount()) worker_arrivals.resize(jobs.getThreadCount());
+			for(auto& arrivals : worker_arrivals) arrivals.clear();
+
+			jobs.parallelFor(ids.size(), CHUNK, [&](size_t begin, size_t end, unsigned worker)
+			{
+				moveSystem(begin, end, hours, worker_arrivals[worker]);
+			});
+
+			jobs.parallelFor(ids.size(), CHUNK, [&](size_t begin, size_t end, unsigned)
+			{
+				supplySystem(begin, end, hours, province_supply);
+				organisationSystem(begin, end, hours);
+			});
+
+			for(auto& arrivals : worker_arrivals)
+			{
+				for(uint32_t index : arrivals) arrive(index);
+			}
+		}
+
+		void copyTo(DivisionSnapshot& snapshot) const
+		{
+			snapshot.ids = ids;
+			snapshot.provinces = provinces;
+			snapshot.next_provinces = next_provinces;
+			snapshot.owners = owners;
+			snapshot.types = types;
+			snapshot.strength = strength;
+			snapshot.organisation = organisation;
+
+			snapshot.progress.resize(progress.size());
+			for(size_t i = 0; i < progress.size(); ++i)
+			{
+				snapshot.progress[i] = step_costs[i] > 0.0f ? min(progress[i] / step_costs[i], 1.0f) : 0.0f;
+			}
+		}
+
+	private:
+		static constexpr uint32_t NONE = UINT32_MAX;
+		static constexpr uint32_t SLOT_BITS = 24;
+		static constexpr uint32_t SLOT_MASK = (1u << SLOT_BITS) - 1;
+
+		// Components, indexed by dense position
+		vector<DivisionId> ids;
+		vector<ProvinceHandle> provinces;
+		vector<CountryId> owners;
+		vector<DivisionType> types;
+		vector<ProvinceHandle> next_provinces;
+		vector<float> progress;			// Cost covered towards the next province
+		vector<float> step_costs;		// Cost of the current step, from the pathfinder
+		vector<float> speeds;
+		vector<float> strength;
+		vector<float> organisation;
+		vector<float> supply;
+		vector<vector<ProvinceHandle>> paths;	// Cold, only read when a step starts
+		vector<uint32_t> path_steps;			// Steps of the path already walked
+
+		// Stationed lists: per province head and count, per division links
+		vector<uint32_t> stationed_first;
+		vector<uint32_t> stationed_count;
+		vector<uint32_t> stationed_prev;
+		vector<uint32_t> stationed_next;
+
+		// Id slot -> dense position
+		vector<uint32_t> slot_dense;
+		vector<uint8_t> slot_generation;
+		vector<uint32_t> free_slots;
+
+		vector<vector<uint32_t>> worker_arrivals;
+
+		DivisionId makeId(uint32_t slot) const { return ((DivisionId)slot_generation[slot] << SLOT_BITS) | slot; }
+
+		uint32_t indexOf(DivisionId id) const
+		{
+			if(id == INVALID_DIVISION) return NONE;
+
+			uint32_t slot = id & SLOT_MASK;
+			if(slot >= slot_dense.size() || slot_generation[slot] != (id >> SLOT_BITS)) return NONE;
+			return slot_dense[slot];
+		}
+
+		void link(uint32_t index, ProvinceHandle province)
+		{
+			stationed_prev[index] = NONE;
+			stationed_next[index] = stationed_first[province];
+			if(stationed_first[province] != NONE) stationed_prev[stationed_first[province]] = index;
+
+			stationed_first[province] = index;
+			stationed_count[province]++;
+		}
+
+		void unlink(uint32_t index, ProvinceHandle province)
+		{
+			if(stationed_prev[index] != NONE) stationed_next[stationed_prev[index]] = stationed_next[index];
+			else stationed_first[province] = stationed_next[index];
+
+			if(stationed_next[index] != NONE) stationed_prev[stationed_next[index]] = stationed_prev[index];
+
+			stationed_count[province]--;
+		}
+
+		void moveDense(uint32_t from, uint32_t to)
+		{
+			ids[to] = ids[from];
+			provinces[to] = provinces[from];
+			owners[to] = owners[from];
+			types[to] = types[from];
+			next_provinces[to] = next_provinces[from];
+			progress[to] = progress[from];
+			step_costs[to] = step_costs[from];
+			speeds[to] = speeds[from];
+			strength[to] = strength[from];
+			organisation[to] = organisation[from];
+			supply[to] = supply[from];
+			paths[to] = move(paths[from]);
+			path_steps[to] = path_steps[from];
+
+			slot_dense[ids[to] & SLOT_MASK] = to;
+		}
+
+		void popDense()
+		{
+			ids.pop_back(); provinces.pop_back(); owners.pop_back(); types.pop_back();
+			next_provinces.pop_back(); progress.pop_back(); step_costs.pop_back(); speeds.pop_back();
+			strength.pop_back(); organisation.pop_back(); supply.pop_back();
+			paths.pop_back(); path_steps.pop_back();
+			stationed_prev.pop_back(); stationed_next.pop_back();
+		}
+
+		// Divisions with a path left and no step under way start the next one
+		void startSteps(const Pathfinder& pathfinder)
+		{
+			for(uint32_t index = 0; index < ids.size(); ++index)
+			{
+				if(next_provinces[index] != INVALID_PROVINCE) continue;
+
+				const auto& path = paths[index];
+				if(path_steps[index] + 1 >= path.size()) continue;
+
+				ProvinceHandle next = path[path_steps[index] + 1];
+				next_provinces[index] = next;
+				step_costs[index] = pathfinder.getStepCost(provinces[index], next);
+				progress[index] = 0.0f;
+			}
+		}
+
+		void moveSystem(size_t begin, size_t end, float hours, vector<uint32_t>& arrivals)
+		{
+			for(size_t i = begin; i < end; ++i)
+			{
+				if(next_provinces[i] == INVALID_PROVINCE) continue;
+
+				// Disorganised divisions march slower
+				progress[i] += speeds[i] * hours * (0.5f + 0.5f * organisation[i]);
+				if(progress[i] >= step_costs[i]) arrivals.push_back((uint32_t)i);
+			}
+		}
+
+		void supplySystem(size_t begin, size_t end, float hours, const float* province_supply)
+		{
+			for(size_t i = begin; i < end; ++i)
+			{
+				float available = province_supply ? province_supply[provinces[i]] : 1.0f;
+				supply[i] = max(0.0f, min(1.0f, supply[i] + (SUPPLY_REFILL * available - SUPPLY_USE) * hours));
+			}
+		}
+
+		void organisationSystem(size_t begin, size_t end, float hours)
+		{
+			for(size_t i = begin; i < end; ++i)
+			{
+				float change = next_provinces[i] == INVALID_PROVINCE ? ORGANISATION_RECOVERY * supply[i] : -ORGANISATION_MARCH_LOSS;
+				organisation[i] = max(0.0f, min(strength[i], organisation[i] + change * hours));
+			}
+		}
+
+		void arrive(uint32_t index)
+		{
+			unlink(index, provinces[index]);
+			provinces[index] = next_provinces[index];
+			link(index, provinces[index]);
+
+			next_provinces[index] = INVALID_PROVINCE;
+			progress[index] = 0.0f;
+			step_costs[index] = 0.0f;
+			path_steps[index]++;
+
+			// Done, the path isn't needed any more
+			if(path_steps[index] + 1 >= paths[index].size())
+			{
+				paths[index].clear();
+				path_steps[index] = 0;
+			}
+		}
+};
@@ -0,0 +1,232 @@
+#pragma once
+
+#include "province.hpp"
+#include "ownership.hpp"
+#include "job_system.hpp"
+#include <cstdint>
+#include <algorithm>
+
+#if defined(__AVX2__)
+	#include <immintrin.h>
+	#define ECONOMY_KERNEL_WIDTH 8
+	#define ECONOMY_KERNEL_NAME "AVX2"
+#elif defined(__SSE2__) || defined(_M_X64)
+	#include <emmintrin.h>
+	#define ECONOMY_KERNEL_WIDTH 4
+	#define ECONOMY_KERNEL_NAME "SSE2"
+#else
+	#define ECONOMY_KERNEL_WIDTH 1
+	#define ECONOMY_KERNEL_NAME "scalar"
+#endif
+
+// Yields per hour of game time for a province fully of one kind. Cities make goods, mountains give ore and
+// timber, open countryside feeds people, coasts trade.
+static constexpr float ECONOMY_INDUSTRY = 3.0f;
+static constexpr float ECONOMY_RESOURCES = 2.0f;
+static constexpr float ECONOMY_FARMING = 1.5f;
+static constexpr float ECONOMY_TRADE = 1.0f;
+static constexpr float ECONOMY_UPKEEP = 1.0f;			// Consumed by every province
+static constexpr float ECONOMY_URBAN_UPKEEP = 2.5f;	// On top, for a fully urban one
+
+// Province attribute columns (0..1) and the economy state the kernel writes
+struct EconomyColumns
+{
+	const float* urban;
+	const float* rugged;
+	const float* coastal;
+	float* production;
+	float* consumption;
+	float* stockpile;
+};
+
+// One province at a time, also handles the tails of the vector kernels
+inline void economyKernelScalar(const EconomyColumns& c, size_t first, size_t last, float hours)
+{
+	for(size_t i = first; i < last; ++i)
+	{
+		float urban = c.urban[i], rugged = c.rugged[i];
+		float countryside = (1.0f - urban) * (1.0f - rugged);
+
+		float production = urban * ECONOMY_INDUSTRY + rugged * ECONOMY_RESOURCES + countryside * ECONOMY_FARMING + c.coastal[i] * ECONOMY_TRADE;
+		float consumption = ECONOMY_UPKEEP + urban * ECONOMY_URBAN_UPKEEP;
+
+		c.production[i] = production;
+		c.consumption[i] = consumption;
+		c.stockpile[i] = max(c.stockpile[i] + (production - consumption) * hours, 0.0f);
+	}
+}
+
+// Same operations in the same order as the scalar loop, 4 or 8 provinces per iteration
+inline void economyKernel(const EconomyColumns& c, size_t first, size_t last, float hours)
+{
+	size_t i = first;
+
+#if ECONOMY_KERNEL_WIDTH == 8
+	const __m256 one = _mm256_set1_ps(1.0f), zero = _mm256_setzero_ps(), vhours = _mm256_set1_ps(hours);
+	const __m256 industry = _mm256_set1_ps(ECONOMY_INDUSTRY), resources = _mm256_set1_ps(ECONOMY_RESOURCES);
+	const __m256 farming = _mm256_set1_ps(ECONOMY_FARMING), trade = _mm256_set1_ps(ECONOMY_TRADE);
+	const __m256 upkeep = _mm256_set1_ps(ECONOMY_UPKEEP), urban_upkeep = _mm256_set1_ps(ECONOMY_URBAN_UPKEEP);
+
+	for(; i + 8 <= last; i += 8)
+	{
+		__m256 urban = _mm256_loadu_ps(c.urban + i), rugged = _mm256_loadu_ps(c.rugged + i);
+		__m256 countryside = _mm256_mul_ps(_mm256_sub_ps(one, urban), _mm256_sub_ps(one, rugged));
+
+		__m256 production = _mm256_add_ps(_mm256_add_ps(_mm256_add_ps(
+			_mm256_mul_ps(urban, industry), _mm256_mul_ps(rugged, resources)),
+			_mm256_mul_ps(countryside, farming)), _mm256_mul_ps(_mm256_loadu_ps(c.coastal + i), trade));
+		__m256 consumption = _mm256_add_ps(upkeep, _mm256_mul_ps(urban, urban_upkeep));
+
+		__m256 stockpile = _mm256_add_ps(_mm256_loadu_ps(c.stockpile + i), _mm256_mul_ps(_mm256_sub_ps(production, consumption), vhours));
+
+		_mm256_storeu_ps(c.production + i, production);
+		_mm256_storeu_ps(c.consumption + i, consumption);
+		_mm256_storeu_ps(c.stockpile + i, _mm256_max_ps(stockpile, zero));
+	}
+#elif ECONOMY_KERNEL_WIDTH == 4
+	const __m128 one = _mm_set1_ps(1.0f), zero = _mm_setzero_ps(), vhours = _mm_set1_ps(hours);
+	const __m128 industry = _mm_set1_ps(ECONOMY_INDUSTRY), resources = _mm_set1_ps(ECONOMY_RESOURCES);
+	const __m128 farming = _mm_set1_ps(ECONOMY_FARMING), trade = _mm_set1_ps(ECONOMY_TRADE);
+	const __m128 upkeep = _mm_set1_ps(ECONOMY_UPKEEP), urban_upkeep = _mm_set1_ps(ECONOMY_URBAN_UPKEEP);
+
+	for(; i + 4 <= last; i += 4)
+	{
+		__m128 urban = _mm_loadu_ps(c.urban + i), rugged = _mm_loadu_ps(c.rugged + i);
+		__m128 countryside = _mm_mul_ps(_mm_sub_ps(one, urban), _mm_sub_ps(one, rugged));
+
+		__m128 production = _mm_add_ps(_mm_add_ps(_mm_add_ps(
+			_mm_mul_ps(urban, industry), _mm_mul_ps(rugged, resources)),
+			_mm_mul_ps(countryside, farming)), _mm_mul_ps(_mm_loadu_ps(c.coastal + i), trade));
+		__m128 consumption = _mm_add_ps(upkeep, _mm_mul_ps(urban, urban_upkeep));
+
+		__m128 stockpile = _mm_add_ps(_mm_loadu_ps(c.stockpile + i), _mm_mul_ps(_mm_sub_ps(production, consumption), vhours));
+
+		_mm_storeu_ps(c.production + i, production);
+		_mm_storeu_ps(c.consumption + i, consumption);
+		_mm_storeu_ps(c.stockpile + i, _mm_max_ps(stockpile, zero));
+	}
+#endif
+
+	economyKernelScalar(c, i, last, hours);
+}
+
+// Sums over every province of a country
+struct CountryEconomy
+{
+	float production = 0.0f;
+	float consumption = 0.0f;
+	float stockpile = 0.0f;
+};
+
+// Production, consumption and stockpiles of every province, as SoA columns run through economyKernel in
+// chunks over the job system. Each chunk also adds its provinces into per worker country totals, which are
+// merged at the end, so the reduction needs no atomics.
+class Economy
+{
+	public:
+		static constexpr size_t CHUNK = 4096;	// Provinces per work item
+
+		void build(const vector<Province>& provinces, const vector<CountryId>& owners)
+		{
+			size_t count = provinces.size();
+			urban.resize(count);
+			rugged.resize(count);
+			coastal.resize(count);
+			production.assign(count, 0.0f);
+			consumption.assign(count, 0.0f);
+			stockpile.assign(count, 0.0f);
+			owner_of = owners;
+
+			for(size_t i = 0; i < count; ++i)
+			{
+				urban[i] = attributeLevel(provinces[i].urban_type);
+				rugged[i] = attributeLevel(provinces[i].mountain_type);
+				coastal[i] = attributeLevel(provinces[i].coast_type);
+			}
+
+			CountryId highest = 0;
+			for(CountryId owner : owners) highest = max(highest, owner);
+			totals.assign(owners.empty() ? 0 : (size_t)highest + 1, CountryEconomy());
+		}
+
+		// NUTS categories 1..3 to 0..1, 1 being the most (urban, mountainous, coastal). 4 and no data are 0.
+		static float attributeLevel(float type)
+		{
+			int level = (int)lroundf(type);
+			return level >= 1 && level <= 3 ? (3 - level) * 0.5f : 0.0f;
+		}
+
+		// The stockpile stays with the province
+		void setOwner(ProvinceHandle handle, CountryId owner)
+		{
+			if(handle >= owner_of.size()) return;
+
+			owner_of[handle] = owner;
+			if(owner >= totals.size()) totals.resize((size_t)owner + 1);
+		}
+
+		// One step of game time, then the country totals
+		void update(float hours, JobSystem& jobs)
+		{
+			size_t count = urban.size();
+			if(count == 0) return;
+
+			unsigned threads = jobs.getThreadCount();
+			worker_totals.resize(threads);
+			for(auto& partial : worker_totals) partial.assign(totals.size(), CountryEconomy());
+
+			EconomyColumns columns = { urban.data(), rugged.data(), coastal.data(), production.data(), consumption.data(), stockpile.data() };
+
+			jobs.parallelFor(count, CHUNK, [&](size_t begin, size_t end, unsigned worker)
+			{
+				economyKernel(columns, begin, end, hours);
+
+				CountryEconomy* partial = worker_totals[worker].data();
+				for(size_t i = begin; i < end; ++i)
+				{
+					CountryEconomy& total = partial[owner_of[i]];
+					total.production += production[i];
+					total.consumption += consumption[i];
+					total.stockpile += stockpile[i];
+				}
+			});
+
+			// Countries split over the workers for the merge too
+			jobs.parallelFor(totals.size(), CHUNK, [&](size_t begin, size_t end, unsigned)
+			{
+				for(size_t country = begin; country < end; ++country)
+				{
+					CountryEconomy sum;
+					for(const auto& partial : worker_totals)
+					{
+						sum.production += partial[country].production;
+						sum.consumption += partial[country].consumption;
+						sum.stockpile += partial[country].stockpile;
+					}
+					totals[country] = sum;
+				}
+			});
+		}
+
+		// Indexed by CountryId
+		const vector<CountryEconomy>& getCountryTotals() const { return totals; }
+
+		float getStockpile(ProvinceHandle handle) const { return handle < stockpile.size() ? stockpile[handle] : 0.0f; }
+		size_t size() const { return urban.size(); }
+
+	private:
+		// Attribute columns, 0..1
+		vector<float> urban;
+		vector<float> rugged;
+		vector<float> coastal;
+
+		// Written by the kernel
+		vector<float> production;
+		vector<float> consumption;
+		vector<float> stockpile;
+
+		vector<CountryId> owner_of;
+
+		vector<CountryEconomy> totals;
+		vector<vector<CountryEconomy>> worker_totals;
+};
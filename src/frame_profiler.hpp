@@ -0,0 +1,179 @@
+#pragma once
+
+#include "raylib.h"
+#include <chrono>
+#include <algorithm>
+#include <cstdint>
+
+using namespace std;
+
+enum FrameStage
+{
+	FRAME_STAGE_INPUT = 0,
+	FRAME_STAGE_PICKING,
+	FRAME_STAGE_CULL,
+	FRAME_STAGE_FILL,
+	FRAME_STAGE_OUTLINE,
+	FRAME_STAGE_HUD,
+
+	FRAME_STAGE_COUNT
+};
+
+static const char* FRAME_STAGE_NAMES[FRAME_STAGE_COUNT] = { "Input", "Picking", "Cull", "Fill", "Outline", "HUD" };
+
+// What the map passes submitted during one frame
+struct FrameCounters
+{
+	uint32_t triangles = 0;
+	uint32_t vertices = 0;
+	uint32_t draw_calls = 0;	// Batches handed to the GPU, one per flush plus one per pass
+	uint32_t flushes = 0;		// Batches drawn early because the next piece wouldn't fit
+};
+
+// CPU time per frame stage and the frame time history, drawn as an overlay.
+// While disabled nothing reads the clock and the counters are left alone.
+class FrameProfiler
+{
+	public:
+		static constexpr int HISTORY = 240;			// Frames in the graph
+		static constexpr float SMOOTHING = 0.1f;	// Weight of the newest frame in the displayed averages
+
+		bool isEnabled() const { return enabled; }
+		void setEnabled(bool enable)
+		{
+			enabled = enable;
+			frame_started = false;
+		}
+
+		// Call at the very start of every frame, the previous frame's totals are closed here
+		void beginFrame()
+		{
+			if(!enabled) return;
+
+			auto now = chrono::steady_clock::now();
+
+			if(frame_started)
+			{
+				float frame_ms = chrono::duration<float, milli>(now - frame_start).count();
+				history[history_next] = frame_ms;
+				history_next = (history_next + 1) % HISTORY;
+				history_count = history_count < HISTORY ? history_count + 1 : HISTORY;
+
+				for(int s = 0; s < FRAME_STAGE_COUNT; ++s)
+				{
+					smoothed[s] += (current[s] - smoothed[s]) * SMOOTHING;
+				}
+				last_counters = counters;
+			}
+
+			frame_start = now;
+			frame_started = true;
+
+			for(float& ms : current) ms = 0.0f;
+			counters = FrameCounters();
+		}
+
+		void addTime(FrameStage stage, float ms) { current[stage] += ms; }
+
+		void addDraw(uint32_t triangles, uint32_t vertices, uint32_t flushes)
+		{
+			if(!enabled) return;
+
+			counters.triangles += triangles;
+			counters.vertices += vertices;
+			counters.flushes += flushes;
+			counters.draw_calls += vertices > 0 ? flushes + 1 : flushes;
+		}
+
+		const FrameCounters& getCounters() const { return last_counters; }
+		float getStageTime(FrameStage stage) const { return smoothed[stage]; }
+
+		// Screen space, outside of BeginMode2D
+		void draw(int x, int y) const
+		{
+			if(!enabled) return;
+
+			const int width = HISTORY + 20;
+			const int graph_height = 60;
+			const int line = 16;
+			const int height = 10 + (FRAME_STAGE_COUNT + 6) * line + graph_height + 10;
+
+			DrawRectangle(x, y, width, height, { 0, 0, 0, 170 });
+
+			int cy = y + 8;
+			DrawText(TextFormat("%d FPS", GetFPS()), x + 10, cy, 16, WHITE);
+			cy += line + 4;
+
+			float total = 0.0f;
+			for(int s = 0; s < FRAME_STAGE_COUNT; ++s)
+			{
+				DrawText(TextFormat("%-8s %6.2f ms", FRAME_STAGE_NAMES[s], smoothed[s]), x + 10, cy, 14, LIGHTGRAY);
+				total += smoothed[s];
+				cy += line;
+			}
+			DrawText(TextFormat("Staged   %6.2f ms", total), x + 10, cy, 14, WHITE);
+			cy += line + 4;
+
+			DrawText(TextFormat("Triangles %u  Vertices %u", last_counters.triangles, last_counters.vertices), x + 10, cy, 14, LIGHTGRAY);
+			cy += line;
+			DrawText(TextFormat("Draw calls %u  Flushes %u", last_counters.draw_calls, last_counters.flushes), x + 10, cy, 14, LIGHTGRAY);
+			cy += line + 6;
+
+			// Frame time graph, scaled so 33 ms fills it, with the 60 FPS budget marked
+			const float scale_ms = 33.3f;
+			int base = cy + graph_height;
+
+			for(int i = 0; i < history_count; ++i)
+			{
+				int index = (history_next - history_count + i + HISTORY) % HISTORY;
+				float ms = history[index];
+
+				int bar = (int)(min(ms / scale_ms, 1.0f) * graph_height);
+				Color color = ms <= 16.7f ? GREEN : (ms <= 33.3f ? YELLOW : RED);
+				DrawLine(x + 10 + i, base, x + 10 + i, base - bar, color);
+			}
+
+			int budget = base - (int)(16.7f / scale_ms * graph_height);
+			DrawLine(x + 10, budget, x + 10 + HISTORY, budget, { 255, 255, 255, 90 });
+		}
+
+	private:
+		bool enabled = false;
+
+		chrono::steady_clock::time_point frame_start;
+		bool frame_started = false;
+
+		float current[FRAME_STAGE_COUNT] = {};
+		float smoothed[FRAME_STAGE_COUNT] = {};
+
+		FrameCounters counters;
+		FrameCounters last_counters;
+
+		float history[HISTORY] = {};
+		int history_next = 0;
+		int history_count = 0;
+};
+
+// Adds the time until the end of the scope to a stage, does nothing without an enabled profiler
+class ProfileScope
+{
+	public:
+		ProfileScope(FrameProfiler* profiler, FrameStage stage)
+			: profiler(profiler && profiler->isEnabled() ? profiler : nullptr), stage(stage)
+		{
+			if(this->profiler) start = chrono::steady_clock::now();
+		}
+
+		~ProfileScope()
+		{
+			if(profiler) profiler->addTime(stage, chrono::duration<float, milli>(chrono::steady_clock::now() - start).count());
+		}
+
+		ProfileScope(const ProfileScope&) = delete;
+		ProfileScope& operator=(const ProfileScope&) = delete;
+
+	private:
+		FrameProfiler* profiler;
+		FrameStage stage;
+		chrono::steady_clock::time_point start;
+};
@@ -0,0 +1,463 @@
+#pragma once
+
+#include "border_mesh.hpp"
+#include "border_buffer.hpp"
+#include "ownership.hpp"
+#include "frame_profiler.hpp"
+#include "rlgl.h"
+#include "raymath.h"
+#include <unordered_map>
+#include <unordered_set>
+#include <algorithm>
+#include <iostream>
+
+#define FRONTLINES_ERR "LakyStrategy::FrontLines::Error: "
+
+// The border segments between provinces of countries at war, grouped per pair of countries and chained into
+// polylines. Segments are re-checked only around provinces that changed owner (or of countries whose war
+// started or ended), and only the fronts that gained or lost segments are chained again.
+// All fronts are drawn as one mesh of Chaikin smoothed polylines, with the border shader.
+class FrontLines
+{
+	public:
+		static constexpr float LINE_WIDTH = 4.0f;		// Pixels
+		static constexpr int SMOOTHING_PASSES = 2;
+		static constexpr int VERTICES_PER_PIECE = 6;	// Two triangles per polyline piece
+
+		void init(const BorderMesh& borders)
+		{
+			size_t count = borders.getSegments().size();
+			segment_front.assign(count, NO_FRONT);
+			segment_slot.assign(count, 0);
+			segment_dirty.assign(count, 0);
+			dirty_segments.clear();
+
+			wars.clear();
+			fronts.clear();
+			front_index.clear();
+			mesh_dirty = true;
+		}
+
+		bool isAtWar(CountryId a, CountryId b) const { return a != b && wars.count(pairKey(a, b)) > 0; }
+
+		// Every border between the two countries is checked again on the next update
+		void setWar(CountryId a, CountryId b, bool war, const BorderMesh& borders, const Ownership& ownership)
+		{
+			if(a == b || isAtWar(a, b) == war) return;
+
+			if(war) wars.insert(pairKey(a, b));
+			else wars.erase(pairKey(a, b));
+
+			// The smaller country's provinces touch every segment between the two
+			CountryId smaller = ownership.getCountry(a).province_count <= ownership.getCountry(b).province_count ? a : b;
+			ownership.collectProvinces(smaller, war_provinces);
+			for(ProvinceHandle handle : war_provinces) markProvinceDirty(handle, borders);
+		}
+
+		size_t getWarCount() const { return wars.size(); }
+
+		// The province changed owner, its segments are checked by the next update
+		void markProvinceDirty(ProvinceHandle handle, const BorderMesh& borders)
+		{
+			for(uint32_t index : borders.getProvinceSegments(handle))
+			{
+				if(segment_dirty.size() <= index || segment_dirty[index]) continue;
+
+				segment_dirty[index] = 1;
+				dirty_segments.push_back(index);
+			}
+		}
+
+		// Moves re-checked segments between fronts, then chains the fronts that changed.
+		// Returns the number of fronts chained again.
+		size_t update(const BorderMesh& borders, const vector<CountryId>& owners)
+		{
+			const auto& segments = borders.getSegments();
+
+			for(uint32_t index : dirty_segments)
+			{
+				segment_dirty[index] = 0;
+
+				const BorderSegment& segment = segments[index];
+				uint32_t front = NO_FRONT;
+
+				if(segment.right != INVALID_PROVINCE && isAtWar(owners[segment.left], owners[segment.right]))
+				{
+					front = getOrCreateFront(owners[segment.left], owners[segment.right]);
+				}
+
+				if(front == segment_front[index]) continue;
+
+				if(segment_front[index] != NO_FRONT) removeSegment(index);
+				if(front != NO_FRONT) addSegment(index, front);
+			}
+			dirty_segments.clear();
+
+			size_t chained = 0;
+			for(Front& front : fronts)
+			{
+				if(!front.dirty) continue;
+
+				chainFront(front, segments);
+				front.dirty = false;
+				mesh_dirty = true;
+				chained++;
+			}
+
+			if(mesh_dirty) buildMesh();
+			return chained;
+		}
+
+		// Fronts with at least one segment
+		size_t getFrontCount() const
+		{
+			return count_if(fronts.begin(), fronts.end(), [](const Front& front) { return !front.segments.empty(); });
+		}
+
+		// GPU side, needs the GL context
+		void upload()
+		{
+			uploaded = true;
+
+			shader = LoadShaderFromMemory(BORDER_BUFFER_VS, BORDER_BUFFER_FS);
+			if(shader.id == 0 || shader.id == rlGetShaderIdDefault())
+			{
+				cerr << FRONTLINES_ERR << "Failed to compile the front line shader, front lines are not drawn" << endl;
+				return;
+			}
+
+			mvp_loc = GetShaderLocation(shader, "mvp");
+			half_width_loc = GetShaderLocation(shader, "halfWidth");
+			ready = true;
+			buffer_dirty = true;
+		}
+
+		// Must be called while the GL context is still alive
+		void unload()
+		{
+			if(!uploaded) return;
+
+			releaseBuffers();
+			if(shader.id != 0) UnloadShader(shader);
+
+			shader = {};
+			ready = false;
+			uploaded = false;
+		}
+
+		bool isUploaded() const { return uploaded; }
+
+		// Every front in one call (inside BeginMode2D)
+		void draw(float zoom, FrameProfiler* profiler = nullptr)
+		{
+			if(!ready) return;
+
+			if(buffer_dirty) uploadMesh();
+			if(vertex_count == 0) return;
+
+			rlDrawRenderBatchActive();
+
+			Matrix mvp = MatrixMultiply(MatrixMultiply(rlGetMatrixTransform(), rlGetMatrixModelview()), rlGetMatrixProjection());
+			float half_width = LINE_WIDTH * 0.5f / max(zoom, 1e-6f);
+
+			rlEnableShader(shader.id);
+			rlSetUniformMatrix(mvp_loc, mvp);
+			rlSetUniform(half_width_loc, &half_width, RL_SHADER_UNIFORM_FLOAT, 1);
+
+			rlDisableBackfaceCulling();
+			rlEnableVertexArray(vao);
+			rlDrawVertexArray(0, (int)vertex_count);
+			rlDisableVertexArray();
+			rlEnableBackfaceCulling();
+			rlDisableShader();
+
+			if(profiler) profiler->addDraw((uint32_t)vertex_count / 3, (uint32_t)vertex_count, 0);
+		}
+
+	private:
+		static constexpr uint32_t NO_FRONT = UINT32_MAX;
+
+		struct Front
+		{
+			CountryId a, b;
+			vector<uint32_t> segments;
+			vector<vector<Vector2>> chains;		// Smoothed
+			bool dirty = false;
+		};
+
+		unordered_set<uint32_t> wars;		// Pair keys
+		vector<ProvinceHandle> war_provinces;
+
+		// Fronts are never removed, an empty one is reused if the war flares up again
+		vector<Front> fronts;
+		unordered_map<uint32_t, uint32_t> front_index;
+
+		// Per segment: its front, its position in that front's list, and whether it waits for a re-check
+		vector<uint32_t> segment_front;
+		vector<uint32_t> segment_slot;
+		vector<uint8_t> segment_dirty;
+		vector<uint32_t> dirty_segments;
+
+		// Mesh of every chain, in the border buffer layout
+		vector<Vector2> positions;
+		vector<Vector2> offsets;
+		vector<Color> colors;
+		size_t vertex_count = 0;
+		Color color = { 200, 30, 30, 230 };
+		bool mesh_dirty = false;
+
+		Shader shader = {};
+		int mvp_loc = -1;
+		int half_width_loc = -1;
+
+		unsigned int vao = 0;
+		unsigned int position_vbo = 0;
+		unsigned int offset_vbo = 0;
+		unsigned int color_vbo = 0;
+		size_t buffer_capacity = 0;		// Vertices
+		bool buffer_dirty = false;
+
+		bool uploaded = false;
+		bool ready = false;
+
+		static uint32_t pairKey(CountryId a, CountryId b)
+		{
+			if(a > b) swap(a, b);
+			return ((uint32_t)a << 16) | b;
+		}
+
+		uint32_t getOrCreateFront(CountryId a, CountryId b)
+		{
+			uint32_t key = pairKey(a, b);
+			auto it = front_index.find(key);
+			if(it != front_index.end()) return it->second;
+
+			uint32_t index = (uint32_t)fronts.size();
+			fronts.push_back({min(a, b), max(a, b), {}, {}, false});
+			front_index[key] = index;
+			return index;
+		}
+
+		void addSegment(uint32_t segment, uint32_t front)
+		{
+			segment_front[segment] = front;
+			segment_slot[segment] = (uint32_t)fronts[front].segments.size();
+			fronts[front].segments.push_back(segment);
+			fronts[front].dirty = true;
+		}
+
+		void removeSegment(uint32_t segment)
+		{
+			Front& front = fronts[segment_front[segment]];
+			uint32_t slot = segment_slot[segment];
+
+			front.segments[slot] = front.segments.back();
+			segment_slot[front.segments[slot]] = slot;
+			front.segments.pop_back();
+			front.dirty = true;
+
+			segment_front[segment] = NO_FRONT;
+		}
+
+		// Links the front's segments end to end. Chains start at vertices that aren't shared by exactly two
+		// segments (ends and forks), what's left after that are closed loops (an enclave at war with its host).
+		void chainFront(Front& front, const vector<BorderSegment>& segments)
+		{
+			front.chains.clear();
+			if(front.segments.empty()) return;
+
+			struct End
+			{
+				uint64_t key;
+				uint32_t piece;		// Into front.segments
+			};
+
+			vector<End> ends;
+			ends.reserve(front.segments.size() * 2);
+			for(uint32_t piece = 0; piece < front.segments.size(); ++piece)
+			{
+				const BorderSegment& segment = segments[front.segments[piece]];
+				ends.push_back({BorderMesh::quantize(segment.a), piece});
+				ends.push_back({BorderMesh::quantize(segment.b), piece});
+			}
+			sort(ends.begin(), ends.end(), [](const End& x, const End& y) { return x.key < y.key; });
+
+			auto endsAt = [&](uint64_t key)
+			{
+				auto first = lower_bound(ends.begin(), ends.end(), key, [](const End& e, uint64_t k) { return e.key < k; });
+				auto last = first;
+				while(last != ends.end() && last->key == key) ++last;
+				return make_pair(first, last);
+			};
+
+			vector<uint8_t> used(front.segments.size(), 0);
+
+			auto walk = [&](uint32_t piece, uint64_t from_key)
+			{
+				vector<Vector2> chain;
+				uint64_t key = from_key;
+
+				while(true)
+				{
+					used[piece] = 1;
+					const BorderSegment& segment = segments[front.segments[piece]];
+					bool forward = BorderMesh::quantize(segment.a) == key;
+
+					if(chain.empty()) chain.push_back(forward ? segment.a : segment.b);
+					chain.push_back(forward ? segment.b : segment.a);
+					key = BorderMesh::quantize(forward ? segment.b : segment.a);
+
+					// Only continue through plain joints, a fork ends the chain
+					auto range = endsAt(key);
+					if(range.second - range.first != 2) break;
+
+					uint32_t next = range.first->piece == piece ? (range.first + 1)->piece : range.first->piece;
+					if(used[next]) break;
+					piece = next;
+				}
+
+				smooth(chain);
+				front.chains.push_back(move(chain));
+			};
+
+			for(size_t i = 0; i < ends.size();)
+			{
+				size_t j = i;
+				while(j < ends.size() && ends[j].key == ends[i].key) ++j;
+
+				if(j - i != 2)
+				{
+					for(size_t k = i; k < j; ++k)
+					{
+						if(!used[ends[k].piece]) walk(ends[k].piece, ends[k].key);
+					}
+				}
+				i = j;
+			}
+
+			for(uint32_t piece = 0; piece < front.segments.size(); ++piece)
+			{
+				if(!used[piece]) walk(piece, BorderMesh::quantize(segments[front.segments[piece]].a));
+			}
+		}
+
+		// Chaikin corner cutting, open chains keep their end points
+		static void smooth(vector<Vector2>& chain)
+		{
+			bool closed = chain.size() > 2 && BorderMesh::quantize(chain.front()) == BorderMesh::quantize(chain.back());
+
+			vector<Vector2> next;
+			for(int pass = 0; pass < SMOOTHING_PASSES && chain.size() > 2; ++pass)
+			{
+				next.clear();
+				if(!closed) next.push_back(chain.front());
+
+				for(size_t i = 0; i + 1 < chain.size(); ++i)
+				{
+					next.push_back(Vector2Lerp(chain[i], chain[i + 1], 0.25f));
+					next.push_back(Vector2Lerp(chain[i], chain[i + 1], 0.75f));
+				}
+
+				if(closed) next.push_back(next.front());
+				else next.push_back(chain.back());
+
+				chain.swap(next);
+			}
+		}
+
+		// Quads pushed out in the shader like the border buffer's, pieces overlap at the joints
+		void buildMesh()
+		{
+			mesh_dirty = false;
+			buffer_dirty = true;
+
+			positions.clear();
+			offsets.clear();
+			colors.clear();
+
+			for(const Front& front : fronts)
+			{
+				for(const auto& chain : front.chains)
+				{
+					for(size_t i = 0; i + 1 < chain.size(); ++i)
+					{
+						Vector2 a = chain[i], b = chain[i + 1];
+						Vector2 d = Vector2Normalize(Vector2Subtract(b, a));
+						Vector2 n = { -d.y, d.x };
+
+						Vector2 corner_positions[4] = { a, a, b, b };
+						Vector2 corner_offsets[4] = {
+							{ -d.x + n.x, -d.y + n.y },
+							{ -d.x - n.x, -d.y - n.y },
+							{ d.x + n.x, d.y + n.y },
+							{ d.x - n.x, d.y - n.y }
+						};
+
+						static const int CORNERS[VERTICES_PER_PIECE] = { 0, 1, 2, 2, 1, 3 };
+						for(int v = 0; v < VERTICES_PER_PIECE; ++v)
+						{
+							positions.push_back(corner_positions[CORNERS[v]]);
+							offsets.push_back(corner_offsets[CORNERS[v]]);
+							colors.push_back(color);
+						}
+					}
+				}
+			}
+
+			vertex_count = positions.size();
+		}
+
+		// Sub-buffer updates while the mesh fits, new buffers (half again as big) when it doesn't
+		void uploadMesh()
+		{
+			buffer_dirty = false;
+			if(vertex_count == 0) return;
+
+			if(vertex_count <= buffer_capacity)
+			{
+				rlUpdateVertexBuffer(position_vbo, positions.data(), (int)(vertex_count * sizeof(Vector2)), 0);
+				rlUpdateVertexBuffer(offset_vbo, offsets.data(), (int)(vertex_count * sizeof(Vector2)), 0);
+				rlUpdateVertexBuffer(color_vbo, colors.data(), (int)(vertex_count * sizeof(Color)), 0);
+				return;
+			}
+
+			releaseBuffers();
+			buffer_capacity = vertex_count + vertex_count / 2;
+
+			positions.resize(buffer_capacity);
+			offsets.resize(buffer_capacity);
+			colors.resize(buffer_capacity);
+
+			vao = rlLoadVertexArray();
+			rlEnableVertexArray(vao);
+
+			position_vbo = rlLoadVertexBuffer(positions.data(), (int)(buffer_capacity * sizeof(Vector2)), true);
+			rlSetVertexAttribute(RL_DEFAULT_SHADER_ATTRIB_LOCATION_POSITION, 2, RL_FLOAT, false, 0, 0);
+			rlEnableVertexAttribute(RL_DEFAULT_SHADER_ATTRIB_LOCATION_POSITION);
+
+			offset_vbo = rlLoadVertexBuffer(offsets.data(), (int)(buffer_capacity * sizeof(Vector2)), true);
+			rlSetVertexAttribute(RL_DEFAULT_SHADER_ATTRIB_LOCATION_TEXCOORD, 2, RL_FLOAT, false, 0, 0);
+			rlEnableVertexAttribute(RL_DEFAULT_SHADER_ATTRIB_LOCATION_TEXCOORD);
+
+			color_vbo = rlLoadVertexBuffer(colors.data(), (int)(buffer_capacity * sizeof(Color)), true);
+			rlSetVertexAttribute(RL_DEFAULT_SHADER_ATTRIB_LOCATION_COLOR, 4, RL_UNSIGNED_BYTE, true, 0, 0);
+			rlEnableVertexAttribute(RL_DEFAULT_SHADER_ATTRIB_LOCATION_COLOR);
+
+			rlDisableVertexArray();
+
+			positions.resize(vertex_count);
+			offsets.resize(vertex_count);
+			colors.resize(vertex_count);
+		}
+
+		void releaseBuffers()
+		{
+			if(buffer_capacity == 0) return;
+
+			rlUnloadVertexArray(vao);
+			rlUnloadVertexBuffer(position_vbo);
+			rlUnloadVertexBuffer(offset_vbo);
+			rlUnloadVertexBuffer(color_vbo);
+			buffer_capacity = 0;
+		}
+};
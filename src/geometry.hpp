@@ -0,0 +1,267 @@
+#pragma once
+
+#include "raylib.h"
+#include <vector>
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+
+using namespace std;
+
+// Small polygon helpers shared by the map modules
+
+// Positive for one winding, negative for the other (screen space has y pointing down)
+inline float ringSignedArea(const vector<Vector2>& ring)
+{
+	double area = 0.0;
+	for(size_t i = 0, j = ring.size() - 1; i < ring.size(); j = i++)
+	{
+		area += (double)ring[j].x * ring[i].y - (double)ring[i].x * ring[j].y;
+	}
+	return (float)(area * 0.5);
+}
+
+// Crossing number test, same rule as MapEngine::getProvinceAt
+inline bool ringContains(const vector<Vector2>& ring, Vector2 point)
+{
+	bool inside = false;
+	for (size_t i = 0, j = ring.size() - 1; i < ring.size(); j = i++) {
+		if (((ring[i].y > point.y) != (ring[j].y > point.y)) &&
+			(point.x < (ring[j].x - ring[i].x) * (point.y - ring[i].y) /
+			(ring[j].y - ring[i].y) + ring[i].x)) {
+			inside = !inside;
+		}
+	}
+	return inside;
+}
+
+inline float pointSegmentDistanceSq(Vector2 p, Vector2 a, Vector2 b)
+{
+	float dx = b.x - a.x, dy = b.y - a.y;
+	float length_sq = dx * dx + dy * dy;
+
+	float t = 0.0f;
+	if(length_sq > 0.0f)
+	{
+		t = ((p.x - a.x) * dx + (p.y - a.y) * dy) / length_sq;
+		t = t < 0.0f ? 0.0f : (t > 1.0f ? 1.0f : t);
+	}
+
+	float ex = a.x + t * dx - p.x;
+	float ey = a.y + t * dy - p.y;
+	return ex * ex + ey * ey;
+}
+
+// Douglas-Peucker on points[first..last], both ends are always kept.
+// Appends the kept points except the last one, so consecutive runs can be chained without duplicates.
+inline void simplifyRun(const vector<Vector2>& points, size_t first, size_t last, float tolerance, vector<Vector2>& out)
+{
+	vector<char> keep(last - first + 1, 0);
+	keep.front() = keep.back() = 1;
+
+	float tolerance_sq = tolerance * tolerance;
+
+	vector<pair<size_t, size_t>> stack;
+	stack.push_back({first, last});
+
+	while(!stack.empty())
+	{
+		size_t a = stack.back().first;
+		size_t b = stack.back().second;
+		stack.pop_back();
+
+		float worst = 0.0f;
+		size_t worst_index = a;
+
+		for(size_t i = a + 1; i < b; ++i)
+		{
+			float distance = pointSegmentDistanceSq(points[i], points[a], points[b]);
+			if(distance > worst)
+			{
+				worst = distance;
+				worst_index = i;
+			}
+		}
+
+		if(worst > tolerance_sq)
+		{
+			keep[worst_index - first] = 1;
+			stack.push_back({a, worst_index});
+			stack.push_back({worst_index, b});
+		}
+	}
+
+	for(size_t i = first; i < last; ++i)
+	{
+		if(keep[i - first]) out.push_back(points[i]);
+	}
+}
+
+// Splits items into spatially compact groups: recursively cuts at the median centre along the longer axis
+// until every group weighs at most `budget`. Items are reordered in place, groups are [first, last) ranges of them.
+// A single item heavier than the budget ends up alone in its group.
+inline void partitionByMedian(vector<uint32_t>& items, size_t first, size_t last, const vector<Vector2>& centres,
+	const vector<uint32_t>& weights, uint32_t budget, vector<pair<size_t, size_t>>& groups)
+{
+	uint64_t total = 0;
+	float minX = 1e30f, minY = 1e30f, maxX = -1e30f, maxY = -1e30f;
+
+	for(size_t i = first; i < last; ++i)
+	{
+		total += weights[items[i]];
+
+		const Vector2& c = centres[items[i]];
+		minX = min(minX, c.x); maxX = max(maxX, c.x);
+		minY = min(minY, c.y); maxY = max(maxY, c.y);
+	}
+
+	if(total <= budget || last - first <= 1)
+	{
+		groups.push_back({first, last});
+		return;
+	}
+
+	bool split_x = (maxX - minX) >= (maxY - minY);
+	size_t middle = first + (last - first) / 2;
+
+	nth_element(items.begin() + first, items.begin() + middle, items.begin() + last, [&](uint32_t a, uint32_t b)
+	{
+		return split_x ? centres[a].x < centres[b].x : centres[a].y < centres[b].y;
+	});
+
+	partitionByMedian(items, first, middle, centres, weights, budget, groups);
+	partitionByMedian(items, middle, last, centres, weights, budget, groups);
+}
+
+// Distance from a point to the ring outline, negative outside the ring
+inline float ringSignedDistance(const vector<Vector2>& ring, Vector2 point)
+{
+	float best = 1e30f;
+	for(size_t i = 0, j = ring.size() - 1; i < ring.size(); j = i++)
+	{
+		best = min(best, pointSegmentDistanceSq(point, ring[j], ring[i]));
+	}
+
+	float distance = sqrtf(best);
+	return ringContains(ring, point) ? distance : -distance;
+}
+
+// Pole of inaccessibility (the polylabel algorithm): the interior point farthest from the outline.
+// Good spot for a label, unlike the centroid it is always inside, even for C shaped rings.
+inline Vector2 ringInteriorPoint(const vector<Vector2>& ring, float precision, int max_cells = 4096)
+{
+	float minX = ring[0].x, minY = ring[0].y, maxX = minX, maxY = minY;
+	for(const auto& p : ring)
+	{
+		minX = min(minX, p.x); minY = min(minY, p.y);
+		maxX = max(maxX, p.x); maxY = max(maxY, p.y);
+	}
+
+	float cell_size = min(maxX - minX, maxY - minY);
+	if(cell_size <= 0.0f) return ring[0];
+
+	struct Cell
+	{
+		Vector2 centre;
+		float half;
+		float distance;
+		float potential;	// Best distance any point in the cell could have
+	};
+
+	auto makeCell = [&](float x, float y, float half) -> Cell
+	{
+		float distance = ringSignedDistance(ring, {x, y});
+		return { {x, y}, half, distance, distance + half * 1.41421356f };
+	};
+
+	auto lower = [](const Cell& a, const Cell& b) { return a.potential < b.potential; };
+	vector<Cell> queue;
+
+	float half = cell_size / 2;
+	for(float x = minX; x < maxX; x += cell_size)
+	{
+		for(float y = minY; y < maxY; y += cell_size)
+		{
+			queue.push_back(makeCell(x + half, y + half, half));
+		}
+	}
+	make_heap(queue.begin(), queue.end(), lower);
+
+	Cell best = makeCell((minX + maxX) / 2, (minY + maxY) / 2, 0);
+
+	int cells = (int)queue.size();
+	while(!queue.empty() && cells < max_cells)
+	{
+		pop_heap(queue.begin(), queue.end(), lower);
+		Cell cell = queue.back();
+		queue.pop_back();
+
+		if(cell.distance > best.distance) best = cell;
+
+		// Nothing in this cell can beat the best by more than the precision
+		if(cell.potential - best.distance <= precision) continue;
+
+		float h = cell.half / 2;
+		for(int k = 0; k < 4; ++k)
+		{
+			queue.push_back(makeCell(cell.centre.x + (k & 1 ? h : -h), cell.centre.y + (k & 2 ? h : -h), h));
+			push_heap(queue.begin(), queue.end(), lower);
+		}
+		cells += 4;
+	}
+
+	return best.centre;
+}
+
+// Liang-Barsky clip of segment ab against a rectangle, true if any part of it lies inside
+inline bool segmentIntersectsRect(Vector2 a, Vector2 b, const Rectangle& rect)
+{
+	float t0 = 0.0f, t1 = 1.0f;
+	float dx = b.x - a.x, dy = b.y - a.y;
+
+	const float p[4] = { -dx, dx, -dy, dy };
+	const float q[4] = { a.x - rect.x, rect.x + rect.width - a.x, a.y - rect.y, rect.y + rect.height - a.y };
+
+	for(int k = 0; k < 4; ++k)
+	{
+		if(p[k] == 0.0f)
+		{
+			if(q[k] < 0.0f) return false;	// Parallel and outside
+			continue;
+		}
+
+		float t = q[k] / p[k];
+		if(p[k] < 0.0f) t0 = max(t0, t);
+		else t1 = min(t1, t);
+
+		if(t0 > t1) return false;
+	}
+	return true;
+}
+
+// Ring outline crosses the rectangle, or one contains the other
+inline bool ringIntersectsRect(const vector<Vector2>& ring, const Rectangle& rect)
+{
+	if(ring.empty()) return false;
+
+	for(size_t i = 0, j = ring.size() - 1; i < ring.size(); j = i++)
+	{
+		if(segmentIntersectsRect(ring[j], ring[i], rect)) return true;
+	}
+
+	return ringContains(ring, { rect.x, rect.y });
+}
+
+// Squared distance from a point to the ring area, 0 inside
+inline float ringDistanceSq(const vector<Vector2>& ring, Vector2 point)
+{
+	if(ring.empty()) return 1e30f;
+	if(ringContains(ring, point)) return 0.0f;
+
+	float best = 1e30f;
+	for(size_t i = 0, j = ring.size() - 1; i < ring.size(); j = i++)
+	{
+		best = min(best, pointSegmentDistanceSq(point, ring[j], ring[i]));
+	}
+	return best;
+}
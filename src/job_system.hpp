@@ -0,0 +1,151 @@
+#pragma once
+
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <atomic>
+#include <functional>
+#include <vector>
+#include <algorithm>
+#include <climits>
+
+using namespace std;
+
+// Persistent worker threads for data parallel loops.
+// The calling thread takes part in the work as worker 0, the pool threads are workers 1..N.
+class JobSystem
+{
+	public:
+		static constexpr unsigned ALL_CORES = UINT_MAX;
+
+		// ALL_CORES = one thread per core, minus the calling thread. 0 runs everything on the caller.
+		explicit JobSystem(unsigned worker_count = ALL_CORES)
+		{
+			if(worker_count == ALL_CORES)
+			{
+				unsigned cores = thread::hardware_concurrency();
+				worker_count = cores > 1 ? cores - 1 : 0;
+			}
+
+			for(unsigned i = 0; i < worker_count; ++i)
+			{
+				workers.emplace_back([this, i] { workerLoop(i + 1); });
+			}
+		}
+
+		~JobSystem()
+		{
+			{
+				lock_guard<mutex> lock(state_mutex);
+				stopping = true;
+			}
+			wake.notify_all();
+
+			for(auto& worker : workers) worker.join();
+		}
+
+		JobSystem(const JobSystem&) = delete;
+		JobSystem& operator=(const JobSystem&) = delete;
+
+		// Number of threads that can run a job at once, including the caller
+		unsigned getThreadCount() const { return (unsigned)workers.size() + 1; }
+
+		// Calls fn(begin, end, worker) over [0, count) in pieces of `grain` items and waits for all of them.
+		// Small loops run on the calling thread only.
+		template<typename Fn>
+		void parallelFor(size_t count, size_t grain, Fn&& fn)
+		{
+			if(count == 0) return;
+
+			grain = max<size_t>(grain, 1);
+
+			if(workers.empty() || count <= grain)
+			{
+				fn((size_t)0, count, 0u);
+				return;
+			}
+
+			// Only one loop at a time, callers on other threads wait their turn
+			lock_guard<mutex> dispatch(dispatch_mutex);
+
+			{
+				lock_guard<mutex> lock(state_mutex);
+				job = [&fn](size_t begin, size_t end, unsigned worker) { fn(begin, end, worker); };
+				job_count = count;
+				job_grain = grain;
+				next_item.store(0);
+				active_workers = (unsigned)workers.size();
+				generation++;
+			}
+			wake.notify_all();
+
+			runJob(0);
+
+			unique_lock<mutex> lock(state_mutex);
+			finished.wait(lock, [this] { return active_workers == 0; });
+			job = nullptr;
+		}
+
+	private:
+		vector<thread> workers;
+
+		mutex dispatch_mutex;
+		mutex state_mutex;
+		condition_variable wake;
+		condition_variable finished;
+
+		function<void(size_t, size_t, unsigned)> job;
+		size_t job_count = 0;
+		size_t job_grain = 1;
+		atomic<size_t> next_item{0};
+
+		unsigned active_workers = 0;
+		uint64_t generation = 0;
+		bool stopping = false;
+
+		void runJob(unsigned worker)
+		{
+			for(;;)
+			{
+				size_t begin = next_item.fetch_add(job_grain);
+				if(begin >= job_count) break;
+
+				job(begin, min(begin + job_grain, job_count), worker);
+			}
+		}
+
+		void workerLoop(unsigned worker)
+		{
+			uint64_t seen = 0;
+
+			unique_lock<mutex> lock(state_mutex);
+			for(;;)
+			{
+				wake.wait(lock, [&] { return stopping || generation != seen; });
+				if(stopping) return;
+
+				seen = generation;
+				lock.unlock();
+
+				runJob(worker);
+
+				lock.lock();
+				if(--active_workers == 0) finished.notify_one();
+			}
+		}
+};
+
+// The simulation's pool and the renderer's pool run at the same time, so they split the cores instead of each
+// taking all of them: the simulation gets half (rounded down), the renderer the rest. Both counts include the
+// pool's calling thread, which is always there, so they are workers to pass to JobSystem plus one.
+inline unsigned simulationThreadCount()
+{
+	unsigned cores = max(thread::hardware_concurrency(), 1u);
+	return max(cores / 2, 1u);
+}
+
+inline unsigned renderThreadCount()
+{
+	unsigned cores = max(thread::hardware_concurrency(), 1u);
+	return max(cores - cores / 2, 1u);
+}
@@ -1,17 +1,27 @@
 #include "raylib.h"
 #include <string>
 #include "map_engine.hpp"
+#include "simulation.hpp"
+#include "benchmarks.hpp"
 
 #define TITLE "LakyStrategy"
 #define VERSION_NUM "0.1.1"
 #define LAKYSTRATEGY_ERROR "LakyStrategy::Error: "
+#define INTERACTIVE_FPS_CAP 144
 
-int main() 
+// raylib's desktop platform runs on GLFW (its headers ship in raylib/src/external/glfw/include).
+// glfwPostEmptyEvent is thread safe and wakes the main loop out of event waiting.
+#define GLFW_INCLUDE_NONE
+#include "GLFW/glfw3.h"
+
+int main(int argc, char** argv) 
 {
+	// Kernel micro-benchmarks only, no window
+	if (argc > 1 && string(argv[1]) == "--bench") return runBenchmarks();
+
 	const int screenWidth = 1280;
 	const int screenHeight = 720;
 	InitWindow(screenWidth, screenHeight, (string(TITLE) + " " + string(VERSION_NUM)).c_str());
-	SetTargetFPS(144);
 
 	// --- Load provinces ---
 
@@ -30,6 +40,15 @@ int main()
 		CloseWindow();
 		return 1;
 	}
+
+	// Handle image for picking under the mouse every frame
+	mapEngine.setPickRasterEnabled(true);
+
+	// Game logic ticks on its own thread, the map follows its snapshots
+	Simulation simulation;
+	simulation.setPublishCallback([] { glfwPostEmptyEvent(); });
+	simulation.start(mapEngine.getProvinces(), mapEngine.getProvinceGraph(), mapEngine.getOwnership());
+	uint64_t appliedOwnerVersion = 0;
 	// ----------------------
 
 	Camera2D camera = { 0 };
@@ -41,45 +60,218 @@ int main()
 	Province hoveredProvince;
 	string provinceInfo = "";
 
+	// Shift + drag box selection, in screen space while dragging
+	bool selecting = false;
+	Vector2 selectionStart = { 0, 0 };
+	vector<ProvinceHandle> selection;
+
+	// Country of the last clicked province, Control + click and A hand provinces to it
+	CountryId activeCountry = INVALID_COUNTRY;
+	ProvinceHandle clickedProvince = INVALID_PROVINCE;
+
+	// P marks the hovered province as a path start, the path then follows the cursor
+	ProvinceHandle pathStart = INVALID_PROVINCE;
+	Path path;
+
+	FrameProfiler& profiler = mapEngine.getProfiler();
+
+	// Event driven: while nothing changes and no work is pending, the loop sleeps until the next input event
+	// or simulation snapshot instead of redrawing the same frame. The frame rate cap for interaction is opt-in,
+	// it's always on while the simulation runs so fast game speeds can't make the loop spin.
+	bool eventDriven = true;
+	bool frameCap = false;
+	bool capped = false;
+
 	while (!WindowShouldClose())
 	{
-
-		// FPS counter in title
-		SetWindowTitle((string(TITLE) + " " + string(VERSION_NUM) + " - " + to_string(GetFPS()) + " FPS").c_str());
+		profiler.beginFrame();
 
 		// Update
-		
-		// Handle zoom with mouse wheel
-		camera.zoom = expf(logf(camera.zoom) + ((float)GetMouseWheelMove()*0.1f));
-
-		if (camera.zoom > 10.0f) camera.zoom = 10.0f;
-		else if (camera.zoom < 0.1f) camera.zoom = 0.1f;
-
-		// Handle panning with dragging
-		if (IsMouseButtonDown(MOUSE_BUTTON_MIDDLE)) {
-			Vector2 delta = GetMouseDelta();
-			camera.target.x -= delta.x / camera.zoom;
-			camera.target.y -= delta.y / camera.zoom;
+		{
+			ProfileScope inputScope(&profiler, FRAME_STAGE_INPUT);
+
+			// Handle zoom with mouse wheel
+			camera.zoom = expf(logf(camera.zoom) + ((float)GetMouseWheelMove()*0.1f));
+
+			if (camera.zoom > 10.0f) camera.zoom = 10.0f;
+			else if (camera.zoom < 0.1f) camera.zoom = 0.1f;
+
+			// Handle panning with dragging
+			if (IsMouseButtonDown(MOUSE_BUTTON_MIDDLE)) {
+				Vector2 delta = GetMouseDelta();
+				camera.target.x -= delta.x / camera.zoom;
+				camera.target.y -= delta.y / camera.zoom;
+			}
+
+			// Toggle name labels
+			if (IsKeyPressed(KEY_L))
+			{
+				mapEngine.setLabelsEnabled(!mapEngine.getLabelsEnabled());
+			}
+
+			// Cycle map modes
+			if (IsKeyPressed(KEY_M))
+			{
+				mapEngine.setMapMode((MapMode)((mapEngine.getMapMode() + 1) % MAP_MODE_COUNT));
+			}
+
+			// Toggle performance overlay
+			if (IsKeyPressed(KEY_F3))
+			{
+				profiler.setEnabled(!profiler.isEnabled());
+			}
+
+			// Toggle event driven redraw and the frame rate cap
+			if (IsKeyPressed(KEY_F4))
+			{
+				eventDriven = !eventDriven;
+			}
+
+			if (IsKeyPressed(KEY_F5))
+			{
+				frameCap = !frameCap;
+			}
+
+			// Game speed: space pauses, 1-5 pick a speed, 0 runs as fast as possible
+			if (IsKeyPressed(KEY_SPACE))
+			{
+				simulation.setSpeed(simulation.isRunning() ? SIM_PAUSED : SIM_SPEED_1);
+			}
+
+			for (int speed = SIM_SPEED_1; speed <= SIM_SPEED_5; ++speed)
+			{
+				if (IsKeyPressed(KEY_ONE + speed - SIM_SPEED_1)) simulation.setSpeed((SimSpeed)speed);
+			}
+
+			if (IsKeyPressed(KEY_ZERO))
+			{
+				simulation.setSpeed(SIM_UNCAPPED);
+			}
+		}
+
+		// Newest finished tick, owners are only compared when they changed
+		const SimSnapshot& snapshot = simulation.acquireSnapshot();
+		if (snapshot.owner_version != appliedOwnerVersion)
+		{
+			mapEngine.applyOwners(snapshot.owners);
+			appliedOwnerVersion = snapshot.owner_version;
+		}
+
+		// Hover highlight, nearly always answered by the previous province or one of its neighbours
+		{
+			ProfileScope pickingScope(&profiler, FRAME_STAGE_PICKING);
+			mapEngine.updateHover(GetScreenToWorld2D(GetMousePosition(), camera));
+		}
+
+		// Annex the hovered province's country into the active one, the map gets it as one batch
+		if (IsKeyPressed(KEY_A) && activeCountry != INVALID_COUNTRY && mapEngine.getHovered() != INVALID_PROVINCE)
+		{
+			CountryId annexed = mapEngine.getOwner(mapEngine.getHovered());
+			if (annexed != activeCountry)
+			{
+				simulation.post({ SIM_COMMAND_ANNEX, activeCountry, annexed, INVALID_PROVINCE, {} });
+				provinceInfo = mapEngine.getOwnership().getCountry(activeCountry).code + " annexed " + mapEngine.getOwnership().getCountry(annexed).code;
+			}
+		}
+
+		// Deploy a division of the active country in the hovered province, armour with Shift
+		if (IsKeyPressed(KEY_D) && activeCountry != INVALID_COUNTRY && mapEngine.getHovered() != INVALID_PROVINCE)
+		{
+			DivisionType type = (IsKeyDown(KEY_LEFT_SHIFT) || IsKeyDown(KEY_RIGHT_SHIFT)) ? DIVISION_ARMOUR : DIVISION_INFANTRY;
+			simulation.post({ SIM_COMMAND_SPAWN, activeCountry, INVALID_COUNTRY, INVALID_PROVINCE, { mapEngine.getHovered() }, type });
+		}
+
+		// Disband the active country's divisions in the hovered province
+		if (IsKeyPressed(KEY_X) && activeCountry != INVALID_COUNTRY && mapEngine.getHovered() != INVALID_PROVINCE)
+		{
+			simulation.post({ SIM_COMMAND_DISBAND, activeCountry, INVALID_COUNTRY, INVALID_PROVINCE, { mapEngine.getHovered() } });
+		}
+
+		// Build or remove a supply depot in the hovered province, if the active country owns it
+		if (IsKeyPressed(KEY_B) && activeCountry != INVALID_COUNTRY && mapEngine.getHovered() != INVALID_PROVINCE)
+		{
+			simulation.post({ SIM_COMMAND_DEPOT, activeCountry, INVALID_COUNTRY, INVALID_PROVINCE, { mapEngine.getHovered() } });
+		}
+
+		// The active country's divisions in the selection (or the clicked province) march to the right clicked one
+		if (IsMouseButtonPressed(MOUSE_BUTTON_RIGHT) && activeCountry != INVALID_COUNTRY && mapEngine.getHovered() != INVALID_PROVINCE)
+		{
+			SimCommand move = { SIM_COMMAND_MOVE, activeCountry, INVALID_COUNTRY, mapEngine.getHovered(), selection };
+			if (move.provinces.empty() && clickedProvince != INVALID_PROVINCE) move.provinces.push_back(clickedProvince);
+			if (!move.provinces.empty()) simulation.post(move);
+		}
+
+		// Declare war on the hovered province's country, or make peace with it
+		if (IsKeyPressed(KEY_W) && activeCountry != INVALID_COUNTRY && mapEngine.getHovered() != INVALID_PROVINCE)
+		{
+			CountryId enemy = mapEngine.getOwner(mapEngine.getHovered());
+			if (enemy != activeCountry)
+			{
+				bool war = !mapEngine.isAtWar(activeCountry, enemy);
+				mapEngine.setWar(activeCountry, enemy, war);
+				provinceInfo = mapEngine.getOwnership().getCountry(activeCountry).code + (war ? " declared war on " : " made peace with ") + mapEngine.getOwnership().getCountry(enemy).code;
+			}
+		}
+
+		// Path preview from the marked province, cached until a country it crosses changes
+		if (IsKeyPressed(KEY_P))
+		{
+			pathStart = (pathStart == mapEngine.getHovered()) ? INVALID_PROVINCE : mapEngine.getHovered();
+			path = Path();
+		}
+
+		if (pathStart != INVALID_PROVINCE && mapEngine.getHovered() != INVALID_PROVINCE)
+		{
+			mapEngine.getPathfinder().findPath(pathStart, mapEngine.getHovered(), path);
+		}
+
+		// Box selection
+		if (IsMouseButtonPressed(MOUSE_BUTTON_LEFT) && (IsKeyDown(KEY_LEFT_SHIFT) || IsKeyDown(KEY_RIGHT_SHIFT)))
+		{
+			selecting = true;
+			selectionStart = GetMousePosition();
+		}
+		else if (selecting && IsMouseButtonReleased(MOUSE_BUTTON_LEFT))
+		{
+			ProfileScope pickingScope(&profiler, FRAME_STAGE_PICKING);
+
+			Vector2 a = GetScreenToWorld2D(selectionStart, camera);
+			Vector2 b = GetScreenToWorld2D(GetMousePosition(), camera);
+			Rectangle box = { fminf(a.x, b.x), fminf(a.y, b.y), fabsf(b.x - a.x), fabsf(b.y - a.y) };
+
+			mapEngine.getQueries().queryRect(box, selection);
+			provinceInfo = "Selected " + to_string(selection.size()) + " provinces";
+			selecting = false;
 		}
 
 		// Get hovered region
-		if (IsMouseButtonPressed(MOUSE_BUTTON_LEFT)) 
+		if (!selecting && IsMouseButtonPressed(MOUSE_BUTTON_LEFT)) 
 		{
+			ProfileScope pickingScope(&profiler, FRAME_STAGE_PICKING);
+
 			Vector2 mousePos = GetMousePosition();
 			Vector2 worldPos = {
 				(mousePos.x - camera.offset.x) / camera.zoom + camera.target.x,
 				(mousePos.y - camera.offset.y) / camera.zoom + camera.target.y
 			};
 
+			ProvinceHandle clicked = mapEngine.getProvinceHandleAt(worldPos);
 			hoveredProvince = mapEngine.getProvinceAt((int)worldPos.x, (int)worldPos.y);
-			if (hoveredProvince.id != "") {
-				provinceInfo = "Region ID: " + hoveredProvince.id + " | Name: " + hoveredProvince.name;
-			}
 
-			// If CTRL is held
+			// If CTRL is held the province goes to the active country, otherwise its owner becomes the active country
 			if (IsKeyDown(KEY_LEFT_CONTROL) || IsKeyDown(KEY_RIGHT_CONTROL)) 
 			{
-				mapEngine.setProvinceColor(hoveredProvince.id, RED);
+				if (clicked != INVALID_PROVINCE && activeCountry != INVALID_COUNTRY && mapEngine.getOwner(clicked) != activeCountry)
+				{
+					simulation.post({ SIM_COMMAND_TRANSFER, activeCountry, INVALID_COUNTRY, INVALID_PROVINCE, { clicked } });
+					provinceInfo = hoveredProvince.name + " transferred to " + mapEngine.getOwnership().getCountry(activeCountry).code;
+				}
+			}
+			else if (clicked != INVALID_PROVINCE)
+			{
+				activeCountry = mapEngine.getOwner(clicked);
+				clickedProvince = clicked;
+				provinceInfo = "Region ID: " + hoveredProvince.id + " | Name: " + hoveredProvince.name + " | Country: " + mapEngine.getOwnership().getCountry(activeCountry).code;
 			}
 
         }
@@ -88,29 +280,83 @@ int main()
 		BeginDrawing();
 		ClearBackground(DARKBLUE);
 
-		BeginMode2D(camera);
+		// Map layer is cached in a texture, so this is nearly free while nothing changes
+		mapEngine.render_map(camera, camera.zoom > 5.0f);
 
-        mapEngine.render(camera);
+		BeginMode2D(camera);
+		mapEngine.render_highlight(mapEngine.getHovered(), YELLOW);
+		mapEngine.render_path(path, ORANGE);
+		mapEngine.render_front_lines(camera);
+		mapEngine.render_units(snapshot.divisions, camera);
+		EndMode2D();
 
-		if(camera.zoom > 5.0f)
 		{
-			mapEngine.render_outline(camera);
-		}
+			ProfileScope hudScope(&profiler, FRAME_STAGE_HUD);
 
-		EndMode2D();
+			mapEngine.render_labels(camera);
 
-		DrawText(("Provinces: " + to_string(mapEngine.getProvinces().size())).c_str(), 10, 10, 20, WHITE);
-        DrawText("Use mouse to explore", 10, 35, 16, LIGHTGRAY);
-		DrawText("Left Click: Get province info", 10, 55, 16, LIGHTGRAY);
-		DrawText("Control + Left Click: Paint province", 10, 75, 16, LIGHTGRAY);
+			DrawText(("Provinces: " + to_string(mapEngine.getProvinces().size())).c_str(), 10, 10, 20, WHITE);
+			DrawText("Use mouse to explore", 10, 35, 16, LIGHTGRAY);
+			DrawText("Left Click: Get province info", 10, 55, 16, LIGHTGRAY);
+			DrawText("Control + Left Click: Give province to the clicked country", 10, 75, 16, LIGHTGRAY);
+			DrawText("L: Toggle labels", 10, 95, 16, LIGHTGRAY);
+			DrawText(("M: Map mode (" + string(MAP_MODE_NAMES[mapEngine.getMapMode()]) + ")").c_str(), 10, 115, 16, LIGHTGRAY);
+			DrawText("F3: Performance overlay", 10, 135, 16, LIGHTGRAY);
+			DrawText(eventDriven ? "F4: Redraw on change (on)" : "F4: Redraw on change (off)", 10, 155, 16, LIGHTGRAY);
+			DrawText(frameCap ? TextFormat("F5: Frame cap (%d FPS)", INTERACTIVE_FPS_CAP) : "F5: Frame cap (only while the game runs)", 10, 175, 16, LIGHTGRAY);
+			DrawText("Shift + Drag: Select provinces", 10, 195, 16, LIGHTGRAY);
+			DrawText("P: Path from hovered province", 10, 215, 16, LIGHTGRAY);
+			DrawText("A: Annex hovered country into the clicked one", 10, 235, 16, LIGHTGRAY);
+			DrawText(TextFormat("Space, 1-5, 0: Speed (%s, tick %llu, %.0f ticks/s)", SIM_SPEED_NAMES[simulation.getSpeed()],
+				(unsigned long long)snapshot.tick, snapshot.ticks_per_second), 10, 255, 16, LIGHTGRAY);
+			DrawText(TextFormat("D / Shift + D / X: Deploy infantry / armour / disband, Right Click: Move selected divisions (%d divisions)", (int)snapshot.divisions.ids.size()), 10, 275, 16, LIGHTGRAY);
+			DrawText("B: Build or remove a supply depot in the hovered province", 10, 295, 16, LIGHTGRAY);
+			DrawText("W: Declare war on / make peace with the hovered country", 10, 315, 16, LIGHTGRAY);
 
-		// Show hovered region info
-        if (!provinceInfo.empty()) {
-            DrawText(provinceInfo.c_str(), 10, screenHeight - 30, 16, YELLOW);
-        }
+			if (activeCountry != INVALID_COUNTRY && activeCountry < snapshot.economy.size())
+			{
+				const CountryEconomy& economy = snapshot.economy[activeCountry];
+				DrawText(TextFormat("%s: production %.0f, consumption %.0f per hour, stockpile %.0f", mapEngine.getOwnership().getCountry(activeCountry).code.c_str(),
+					economy.production, economy.consumption, economy.stockpile), 10, 340, 16, WHITE);
+			}
+
+			if (selecting)
+			{
+				Vector2 mouse = GetMousePosition();
+				Rectangle box = { fminf(selectionStart.x, mouse.x), fminf(selectionStart.y, mouse.y), fabsf(mouse.x - selectionStart.x), fabsf(mouse.y - selectionStart.y) };
+				DrawRectangleLinesEx(box, 1.0f, YELLOW);
+			}
+
+			ProvinceHandle hovered = mapEngine.getHovered();
+			if (hovered != INVALID_PROVINCE)
+			{
+				float supply = hovered < snapshot.supply.size() ? snapshot.supply[hovered] : 0.0f;
+				DrawText(TextFormat("%s (supply %.0f%%)", mapEngine.getProvinces()[hovered].name.c_str(), supply * 100.0f), 10, screenHeight - 50, 16, WHITE);
+			}
+
+			// Show hovered region info
+			if (!provinceInfo.empty()) {
+				DrawText(provinceInfo.c_str(), 10, screenHeight - 30, 16, YELLOW);
+			}
+
+			profiler.draw(screenWidth - 270, 10);
+		}
+
+		if (capped != (frameCap || simulation.isRunning()))
+		{
+			capped = !capped;
+			SetTargetFPS(capped ? INTERACTIVE_FPS_CAP : 0);
+		}
+
+		// The profiler overlay, pending tiles and unseen snapshots need frames of their own, anything else waits for
+		// input or the next snapshot
+		if (eventDriven && !profiler.isEnabled() && !mapEngine.hasPendingWork() && !simulation.needsFrames()) EnableEventWaiting();
+		else DisableEventWaiting();
 
 		EndDrawing();
 	}
+	simulation.stop();
+	mapEngine.Unload();
 	CloseWindow();
 	return 0;
 }
\ No newline at end of file
@@ -0,0 +1,213 @@
+#pragma once
+
+#include "raylib.h"
+#include "rlgl.h"
+#include <cmath>
+#include <utility>
+
+// What the cache had to do for the last frame
+enum MapCacheAction
+{
+	MAP_CACHE_REUSE = 0,	// Nothing changed, the cached texture was drawn as is
+	MAP_CACHE_PATCH,		// Small pan: old contents scrolled, only the exposed strips re-rendered
+	MAP_CACHE_REDRAW		// Everything re-rendered (zoom change, dirty colours, big jump...)
+};
+
+// Keeps the rendered map layer in a render texture and re-renders as little of it as possible
+class MapCache
+{
+	public:
+		// Extra pixels around the screen so the sub-pixel offset when presenting never exposes an edge
+		static constexpr int MARGIN = 2;
+
+		~MapCache() {}
+
+		bool isReady() const { return ready; }
+
+		void init(int screen_w, int screen_h)
+		{
+			width = screen_w + MARGIN * 2;
+			height = screen_h + MARGIN * 2;
+
+			targets[0] = LoadRenderTexture(width, height);
+			targets[1] = LoadRenderTexture(width, height);
+			current = 0;
+
+			ready = true;
+			valid = false;
+		}
+
+		// Must be called while the GL context is still alive
+		void unload()
+		{
+			if(!ready) return;
+
+			UnloadRenderTexture(targets[0]);
+			UnloadRenderTexture(targets[1]);
+			ready = false;
+		}
+
+		// Forces a full redraw next frame (province colours changed etc.)
+		void invalidate() { valid = false; }
+
+		MapCacheAction getLastAction() const { return last_action; }
+
+		// Brings the cached texture up to date for this camera.
+		// draw(camera, area) must render the map layer with the given camera, culled to the world space area.
+		template<typename DrawFn>
+		void update(const Camera2D& camera, bool outlines, Color background, DrawFn draw)
+		{
+			if(!ready) return;
+
+			bool same_view = valid
+				&& camera.zoom == cached.zoom
+				&& camera.rotation == 0.0f && cached.rotation == 0.0f
+				&& camera.offset.x == cached.offset.x && camera.offset.y == cached.offset.y
+				&& outlines == cached_outlines;
+
+			if(!same_view)
+			{
+				redraw(camera, outlines, background, draw);
+				return;
+			}
+
+			// How far (in whole pixels) the cached contents have to move to line up with the camera
+			float shift_x = roundf((cached.target.x - camera.target.x) * camera.zoom);
+			float shift_y = roundf((cached.target.y - camera.target.y) * camera.zoom);
+
+			if(shift_x == 0.0f && shift_y == 0.0f)
+			{
+				last_action = MAP_CACHE_REUSE;
+				return;
+			}
+
+			if(fabsf(shift_x) >= width / 2 || fabsf(shift_y) >= height / 2)
+			{
+				// Most of the screen is new anyway
+				redraw(camera, outlines, background, draw);
+				return;
+			}
+
+			// Move the cache camera by exactly the pixel shift, so the old pixels are still correct
+			cached.target.x -= shift_x / camera.zoom;
+			cached.target.y -= shift_y / camera.zoom;
+
+			int previous = current;
+			current = 1 - current;
+
+			BeginTextureMode(targets[current]);
+
+			drawOpaque(targets[previous], {shift_x, shift_y});
+
+			Camera2D cache_camera = getCacheCamera();
+
+			// Vertical strip exposed on the left or right
+			if(shift_x != 0.0f)
+			{
+				int strip_x = shift_x > 0.0f ? 0 : width + (int)shift_x;
+				drawStrip(cache_camera, background, strip_x, 0, (int)fabsf(shift_x), height, draw);
+			}
+
+			// Horizontal strip exposed on the top or bottom
+			if(shift_y != 0.0f)
+			{
+				int strip_y = shift_y > 0.0f ? 0 : height + (int)shift_y;
+				drawStrip(cache_camera, background, 0, strip_y, width, (int)fabsf(shift_y), draw);
+			}
+
+			EndTextureMode();
+
+			last_action = MAP_CACHE_PATCH;
+		}
+
+		// Draws the cached layer to the screen (outside of BeginMode2D)
+		void present(const Camera2D& camera)
+		{
+			if(!ready || !valid) return;
+
+			// Left over sub-pixel offset between the cache camera and the real one
+			Vector2 position = {
+				(cached.target.x - camera.target.x) * camera.zoom - MARGIN,
+				(cached.target.y - camera.target.y) * camera.zoom - MARGIN
+			};
+
+			drawOpaque(targets[current], position);
+		}
+
+	private:
+		RenderTexture2D targets[2] = {};
+		int current = 0;
+		int width = 0, height = 0;
+
+		bool ready = false;
+		bool valid = false;
+
+		Camera2D cached = {};
+		bool cached_outlines = false;
+
+		MapCacheAction last_action = MAP_CACHE_REDRAW;
+
+		Camera2D getCacheCamera() const
+		{
+			Camera2D cache_camera = cached;
+			cache_camera.offset.x += MARGIN;
+			cache_camera.offset.y += MARGIN;
+			return cache_camera;
+		}
+
+		template<typename DrawFn>
+		void redraw(const Camera2D& camera, bool outlines, Color background, DrawFn& draw)
+		{
+			cached = camera;
+			cached_outlines = outlines;
+
+			Camera2D cache_camera = getCacheCamera();
+
+			BeginTextureMode(targets[current]);
+			ClearBackground(background);
+
+			BeginMode2D(cache_camera);
+			draw(cache_camera, screenToWorld(cache_camera, 0, 0, width, height));
+			EndMode2D();
+
+			EndTextureMode();
+
+			valid = true;
+			last_action = MAP_CACHE_REDRAW;
+		}
+
+		template<typename DrawFn>
+		void drawStrip(const Camera2D& cache_camera, Color background, int x, int y, int w, int h, DrawFn& draw)
+		{
+			BeginScissorMode(x, y, w, h);
+			ClearBackground(background);
+
+			BeginMode2D(cache_camera);
+			draw(cache_camera, screenToWorld(cache_camera, x, y, w, h));
+			EndMode2D();
+
+			EndScissorMode();
+		}
+
+		// Copies a cached layer without blending: the fills are translucent, so the alpha channel of the
+		// texture is not 255 even though the colour already contains the background
+		void drawOpaque(const RenderTexture2D& target, Vector2 position)
+		{
+			rlDrawRenderBatchActive();
+			rlDisableColorBlend();
+
+			// Render textures are stored upside down, so flip the source to keep them upright
+			DrawTextureRec(target.texture, {0, 0, (float)width, -(float)height}, position, WHITE);
+
+			rlDrawRenderBatchActive();
+			rlEnableColorBlend();
+		}
+
+		static Rectangle screenToWorld(const Camera2D& camera, int x, int y, int w, int h)
+		{
+			Vector2 topLeft = GetScreenToWorld2D({(float)x, (float)y}, camera);
+			Vector2 bottomRight = GetScreenToWorld2D({(float)(x + w), (float)(y + h)}, camera);
+
+			return { topLeft.x, topLeft.y, bottomRight.x - topLeft.x, bottomRight.y - topLeft.y };
+		}
+};
@@ -1,7 +1,28 @@
+#pragma once
+
 #include "raylib.h"
 #include "rlgl.h"
 #include "json.hpp"
 #include "earcut.hpp"
+#include "province.hpp"
+#include "border_mesh.hpp"
+#include "border_buffer.hpp"
+#include "map_cache.hpp"
+#include "tile_pyramid.hpp"
+#include "country_mesh.hpp"
+#include "render_chunks.hpp"
+#include "job_system.hpp"
+#include "map_labels.hpp"
+#include "map_modes.hpp"
+#include "frame_profiler.hpp"
+#include "spatial_grid.hpp"
+#include "pick_raster.hpp"
+#include "ring_kernel.hpp"
+#include "province_queries.hpp"
+#include "pathfinding.hpp"
+#include "ownership.hpp"
+#include "unit_counters.hpp"
+#include "front_lines.hpp"
 #include <vector>
 #include <string>
 #include <fstream>
@@ -15,29 +36,6 @@ using json = nlohmann::json;
 
 using namespace std;
 
-struct Province
-{
-	string id;
-
-	string name;
-	string name_en;
-	string name_local;
-	Color color;
-	int admin_level;
-
-	vector<vector<Vector2>> polygons;
-	vector<vector<uint32_t>> polygon_indices;
-	vector<Rectangle> polygon_bounds;
-
-	// NUTS data
-	string country_code;
-	float mountain_type;
-	float urban_type;
-	float coast_type;
-	string nuts_level;
-
-};
-
 class MapEngine
 {
 	private:
@@ -48,6 +46,81 @@ class MapEngine
 
 		int screen_width, screen_height;
 
+		// Ring bounds bucketed into a uniform grid for picking, built once after loading
+		SpatialGrid province_grid;
+
+		// Ring vertices in SoA form for the vectorized containment test
+		PackedRings packed_rings;
+
+		// Neighbouring provinces and their shared border lengths
+		ProvinceGraph graph;
+
+		// Owner of every province and the country colours
+		Ownership ownership;
+		vector<OwnerChange> owner_changes;			// Scratch for transferProvinces
+		vector<ProvinceHandle> transfer_scratch;	// Provinces of one country
+		vector<uint64_t> owner_sync;				// New owner << 32 | province, for applyOwners
+
+		// Terrain weighted movement paths over the graph, clustered by owner
+		Pathfinder pathfinder;
+
+		// Province under the cursor, updated by updateHover
+		ProvinceHandle hovered = INVALID_PROVINCE;
+
+		// Point, rectangle, lasso, radius and nearest queries over the structures above
+		ProvinceQueries queries;
+
+		// Optional handle image answering most picks with one texel read
+		PickRaster pick_raster;
+
+		// Fill triangles grouped into batch sized spatial chunks, built once after loading
+		RenderChunks chunks;
+
+		// Worker threads for frame preparation, on the cores the simulation leaves
+		JobSystem jobs{renderThreadCount() - 1};
+
+		// Stage timings and draw counters for the performance overlay
+		FrameProfiler profiler;
+
+		// Province colours / attributes texture and the map mode shader, uploaded on the first render_map call
+		MapModes map_modes;
+
+		// Province and country names, set up on the first render_labels call
+		MapLabels labels;
+		bool labels_enabled = true;
+		string label_font_path = "./assets/font.ttf";
+
+		// Deduplicated province borders, built once after loading
+		BorderMesh borders;
+		Color border_colors[BORDER_KIND_COUNT] = {
+			DARKGRAY,				// BORDER_COAST
+			{ 80, 80, 80, 140 },	// BORDER_PROVINCE
+			{ 20, 20, 20, 255 }		// BORDER_COUNTRY
+		};
+
+		// The border mesh on the GPU, uploaded on the first render_map call and patched when segments change kind
+		BorderBuffer border_buffer;
+		vector<uint32_t> changed_segments;
+
+		// Division counters, drawn live over the cached map every frame
+		UnitCounters unit_counters;
+
+		// Borders between countries at war, kept up to date as provinces change hands
+		FrontLines front_lines;
+
+		// Map layer cached in a render texture between frames
+		MapCache map_cache;
+		Color background_color = DARKBLUE;
+
+		// Raster tiles used instead of vectors when zoomed out
+		TilePyramid tiles;
+		bool tiles_enabled = true;
+		bool tiles_pending = false;
+
+		// Dissolved per country meshes used instead of provinces when zoomed far out
+		CountryMeshes countries;
+		bool country_meshes_enabled = true;
+
 		// Convert lat/lon to Web Mercator coordinates (EPSG:3857)
 		pair<double, double> latlon_to_mercator(double lat, double lon)
 		{
@@ -122,15 +195,61 @@ class MapEngine
 			return screen;
 		}*/
 
+		// Moves provinces to a country as one batch: every changed province gets its palette entry and its border
+		// segments marked, the two country meshes and labels of each change are rebuilt once on the next render_map
+		size_t transferProvinces(const ProvinceHandle* handles, size_t count, CountryId country)
+		{
+			owner_changes.clear();
+			if(ownership.transfer(handles, count, country, owner_changes) == 0) return 0;
+
+			const Country& owner = ownership.getCountry(country);
+			for(const OwnerChange& change : owner_changes)
+			{
+				Province& province = provinces[change.province];
+
+				// The string stays in sync for code that groups by country code
+				province.country_code = owner.code;
+
+				map_modes.setProvinceColor(change.province, owner.color);
+				borders.markProvinceDirty(change.province);
+				front_lines.markProvinceDirty(change.province, borders);
+				countries.moveProvince(change.province, change.from, change.to);
+				pathfinder.setOwner(change.province, change.to);
+				labels.markCountryDirty(change.from);
+				labels.markCountryDirty(change.to);
+
+				for(const auto& bounds : province.polygon_bounds)
+				{
+					tiles.markStale(bounds);
+				}
+			}
+
+			return owner_changes.size();
+		}
+
 	public:
 		MapEngine(int screen_w = 1280, int screen_h = 720) : screen_width(screen_w), screen_height(screen_h)
 		{
 			min_lat = min_lon = 1e9;
 			max_lat = max_lon = -1e9;
+
+			queries.init(&provinces, &province_grid, &packed_rings, &pick_raster, &graph, &jobs);
 		}
 
 		~MapEngine() {}
 
+		// Releases GPU resources, call before CloseWindow()
+		void Unload()
+		{
+			map_cache.unload();
+			tiles.unload();
+			labels.unload();
+			map_modes.unload();
+			border_buffer.unload();
+			unit_counters.unload();
+			front_lines.unload();
+		}
+
 		bool LoadMap(const string& jsonPath)
 		{
 
@@ -425,6 +544,36 @@ class MapEngine
 				cout << "Sucessfully loaded " << provinces.size() << " provinces!" << endl;
 
 				calculatePolygonBounds();
+				calculateInteriorPoints();
+				province_grid.build(provinces);
+				packed_rings.build(provinces);
+
+				ownership.build(provinces);
+
+				chunks.build(provinces);
+				map_modes.build(provinces);
+				chunks.setProvinceTexcoords(map_modes.getTexcoords());
+				borders.build(provinces, ownership.getOwners());
+				border_buffer.build(borders, border_colors);
+				front_lines.init(borders);
+
+				// Political map shows the owner's colour
+				for(ProvinceHandle handle = 0; handle < provinces.size(); ++handle)
+				{
+					map_modes.setProvinceColor(handle, ownership.getCountry(ownership.getOwner(handle)).color);
+				}
+
+				// Adjacency is the slow part of loading, so it's cached next to the map
+				string graph_cache_path = jsonPath + ".graph";
+				uint64_t fingerprint = ProvinceGraph::fingerprint(provinces);
+				if(!graph.load(graph_cache_path, fingerprint, provinces.size()))
+				{
+					graph.build(provinces, jobs);
+					graph.save(graph_cache_path, fingerprint);
+				}
+				pathfinder.build(provinces, graph, ownership.getOwners());
+				countries.build(provinces, borders, ownership);
+				unit_counters.init(provinces.size());
 
 				return true;
 				
@@ -441,6 +590,15 @@ class MapEngine
 		}
 
 		const vector<Province>& getProvinces() const { return provinces; }
+		const BorderMesh& getBorders() const { return borders; }
+
+		void setBorderColor(BorderKind kind, const Color& color)
+		{
+			border_colors[kind] = color;
+			border_buffer.recolor(borders, border_colors);
+			map_cache.invalidate();
+			tiles.markAllStale();
+		}
 
 		void calculatePolygonBounds()
 		{
@@ -474,6 +632,52 @@ class MapEngine
 			}
 		}
 
+		// World space rectangle covered by the screen
+		Rectangle getViewRect(const Camera2D& camera)
+		{
+			Vector2 topLeft = GetScreenToWorld2D({0, 0}, camera);
+			Vector2 bottomRight = GetScreenToWorld2D({(float)screen_width, (float)screen_height}, camera);
+
+			return { topLeft.x, topLeft.y, bottomRight.x - topLeft.x, bottomRight.y - topLeft.y };
+		}
+
+		// Area and label anchor of every province, spread over the worker threads
+		void calculateInteriorPoints()
+		{
+			jobs.parallelFor(provinces.size(), 64, [&](size_t begin, size_t end, unsigned)
+			{
+				for(size_t i = begin; i < end; ++i)
+				{
+					Province& province = provinces[i];
+					province.area = 0.0f;
+					province.interior_point = {0, 0};
+
+					size_t largest = 0;
+					float largest_area = -1.0f;
+
+					for(size_t poly_index = 0; poly_index < province.polygons.size(); ++poly_index)
+					{
+						if(province.polygons[poly_index].size() < 3) continue;
+
+						float area = fabsf(ringSignedArea(province.polygons[poly_index]));
+						province.area += area;
+
+						if(area > largest_area)
+						{
+							largest_area = area;
+							largest = poly_index;
+						}
+					}
+
+					if(largest_area < 0.0f) continue;
+
+					const Rectangle& bounds = province.polygon_bounds[largest];
+					float precision = max(max(bounds.width, bounds.height) / 100.0f, 0.01f);
+					province.interior_point = ringInteriorPoint(province.polygons[largest], precision);
+				}
+			});
+		}
+
 		bool isVisibleInCamera(const Rectangle& bounds, const Camera2D& camera, int screenWidth, int screenHeight)
 		{
 			// Get the world coordinates of the screen corners
@@ -558,115 +762,432 @@ class MapEngine
 			}
 		}
 
-		void render(Camera2D camera) {
-			rlBegin(RL_TRIANGLES);
-			
-			for(const auto& province : provinces) {
-				rlColor4ub(province.color.r, province.color.g, province.color.b, province.color.a);
-				
-				for(size_t poly_index = 0; poly_index < province.polygons.size(); ++poly_index) {
-					const auto& poly = province.polygons[poly_index];
-					const auto& indices = province.polygon_indices[poly_index];
+		void render(Camera2D camera)
+		{
+			render_region(getViewRect(camera));
+		}
 
-					if(poly_index < province.polygon_bounds.size())
-					{
-						if(!isVisibleInCamera(province.polygon_bounds[poly_index], camera, screen_width, screen_height))
-						{
-							continue; 
-						}
-					}
-					else
+		// Draws the province fills that intersect a world space area
+		void render_region(const Rectangle& area)
+		{
+			bool shaded = map_modes.begin();
+
+			chunks.render(area, provinces, &jobs, &profiler);
+
+			if(shaded) map_modes.end();
+		}
+
+		// Draws the whole map layer through the render texture cache.
+		// Call outside of BeginMode2D, the cache applies the camera itself.
+		void render_map(const Camera2D& camera, bool outlines)
+		{
+			if(!map_cache.isReady())
+			{
+				map_cache.init(screen_width, screen_height);
+			}
+
+			if(!map_modes.isUploaded())
+			{
+				map_modes.upload();
+			}
+			bool changed = map_modes.flushColors();
+
+			if(!border_buffer.isUploaded())
+			{
+				border_buffer.upload();
+			}
+
+			// Border kinds first, the country meshes are chained from them. Only segments that changed kind
+			// are re-coloured on the GPU.
+			changed_segments.clear();
+			borders.classifyDirty(ownership.getOwners(), &changed_segments);
+			border_buffer.patch(changed_segments, borders, border_colors);
+			border_buffer.flush();
+			changed |= !changed_segments.empty();
+
+			changed |= countries.rebuildDirty(provinces, borders, ownership.getOwners());
+
+			// Owner changes reach the cached layer here, once per frame however many batches came in
+			if(changed) map_cache.invalidate();
+
+			// Country labels follow their provinces
+			if(labels.isReady()) labels.updateCountries(provinces, ownership);
+
+			bool use_tiles = tiles_enabled && camera.zoom < TilePyramid::MAX_ZOOM;
+
+			// Picked once from the screen zoom: tiles are rasterized at their level's zoom, which can be on the
+			// other side of the threshold, and must bake the same fills as the vector fallback draws
+			bool use_country_meshes = useCountryMeshes(camera.zoom);
+
+			// Tiles have to be rasterized before the cache starts drawing, render textures can't nest
+			if(use_tiles)
+			{
+				tiles.update(getViewRect(camera), camera.zoom, background_color, [&](const Camera2D& tile_camera, const Rectangle& area)
+				{
+					render_fill_region(area, use_country_meshes);
+				});
+			}
+			tiles_pending = use_tiles && tiles.hasPendingTiles();
+
+			map_cache.update(camera, outlines, background_color, [&](const Camera2D& cache_camera, const Rectangle& area)
+			{
+				if(use_tiles)
+				{
+					// Vectors only where tiles are missing or stale, the tiles are drawn over them
+					Rectangle missing;
+					if(tiles.getMissingBounds(area, cache_camera.zoom, missing))
 					{
-						continue;
-					}
-					
-					for(size_t i = 0; i + 2 < indices.size(); i += 3) {
-						uint32_t idxA = indices[i], idxB = indices[i+1], idxC = indices[i+2];
-						if(idxA >= poly.size() || idxB >= poly.size() || idxC >= poly.size()) continue;
-						
-						rlVertex2f(poly[idxA].x, poly[idxA].y);
-						rlVertex2f(poly[idxC].x, poly[idxC].y);
-						rlVertex2f(poly[idxB].x, poly[idxB].y);
+						render_fill_region(GetCollisionRec(missing, area), use_country_meshes);
 					}
+
+					tiles.draw(area, cache_camera.zoom);
+				}
+				else
+				{
+					render_fill_region(area, use_country_meshes);
+				}
+
+				if(outlines)
+				{
+					render_outline_region(area, cache_camera.zoom);
 				}
+			});
+
+			map_cache.present(camera);
+		}
+
+		// The dissolved country meshes replace the province fills when zoomed out far enough on the political map
+		bool useCountryMeshes(float zoom) const
+		{
+			return country_meshes_enabled && zoom < CountryMeshes::ZOOM_THRESHOLD && map_modes.getMode() == MAP_MODE_POLITICAL;
+		}
+
+		// Province fills, or the dissolved country meshes
+		void render_fill_region(const Rectangle& area, bool country_meshes)
+		{
+			if(country_meshes)
+			{
+				ProfileScope scope(&profiler, FRAME_STAGE_FILL);
+				countries.render(area, border_colors[BORDER_COUNTRY], &profiler);
+			}
+			else
+			{
+				render_region(area);
 			}
-			
-			rlEnd();
+		}
+
+		// Draws the name labels that fit on screen this frame (outside of BeginMode2D)
+		void render_labels(const Camera2D& camera)
+		{
+			if(!labels_enabled) return;
+
+			if(!labels.isReady())
+			{
+				labels.init(provinces, ownership, label_font_path);
+			}
+
+			labels.render(camera, screen_width, screen_height);
+		}
+
+		const MapLabels& getLabels() const { return labels; }
+
+		bool getLabelsEnabled() const { return labels_enabled; }
+		void setLabelsEnabled(bool enabled) { labels_enabled = enabled; }
+		void setLabelFont(const string& fontPath) { label_font_path = fontPath; }
+
+		MapMode getMapMode() const { return map_modes.getMode(); }
+
+		// Only a shader uniform changes, the cached map layer and tiles just need redrawing
+		void setMapMode(MapMode mode)
+		{
+			if(mode == map_modes.getMode()) return;
+
+			map_modes.setMode(mode);
+			map_cache.invalidate();
+			tiles.markAllStale();
+		}
+
+		const TilePyramid& getTiles() const { return tiles; }
+		const CountryMeshes& getCountryMeshes() const { return countries; }
+
+		void setCountryMeshesEnabled(bool enabled)
+		{
+			country_meshes_enabled = enabled;
+			map_cache.invalidate();
+			tiles.markAllStale();
+		}
+
+		void setTilesEnabled(bool enabled)
+		{
+			tiles_enabled = enabled;
+			map_cache.invalidate();
+		}
+
+		FrameProfiler& getProfiler() { return profiler; }
+
+		// Something still wants more frames even if nothing changes (tiles left over by the per frame budget)
+		bool hasPendingWork() const
+		{
+			return tiles_pending;
+		}
+
+		MapCacheAction getMapCacheAction() const { return map_cache.getLastAction(); }
+
+		const RenderChunks& getRenderChunks() const { return chunks; }
+
+		// Fill submission counters (chunks, vertices, batch flushes) since the last reset
+		const ChunkStats& getChunkStats() const { return chunks.getStats(); }
+		void resetChunkStats() { chunks.resetStats(); }
+
+		void setBackgroundColor(const Color& color)
+		{
+			background_color = color;
+			map_cache.invalidate();
+			tiles.markAllStale();
 		}
 
 		void render_outline(Camera2D camera)
 		{
-			const Color edge_color = DARKGRAY;
+			render_outline_region(getViewRect(camera), camera.zoom);
+		}
 
-			for (const auto& province : provinces) {
-				for (size_t poly_index = 0; poly_index < province.polygons.size(); ++poly_index)
-				{
-					const auto& polygon = province.polygons[poly_index];
-					if (polygon.size() < 3) continue;
+		// Zoom sets the line width in world units for the GPU border buffer
+		void render_outline_region(const Rectangle& area, float zoom = 1.0f)
+		{
+			ProfileScope scope(&profiler, FRAME_STAGE_OUTLINE);
 
-					if(poly_index < province.polygon_bounds.size())
-					{
-						if(!isVisibleInCamera(province.polygon_bounds[poly_index], camera, screen_width, screen_height))
-						{
-							continue; 
-						}
-					}
-					else
-					{
-						continue;
-					}
-					
-					// Draw outline
-					for (size_t i = 0; i < polygon.size() - 1; i++) {
-						DrawLineV(polygon[i], polygon[i + 1], DARKGRAY);
-					}
-					// Close the polygon
-					if (polygon.size() > 2) {
-						DrawLineV(polygon.back(), polygon[0], DARKGRAY);
-					}
+			if(border_buffer.isReady())
+			{
+				border_buffer.draw(borders, area, zoom, &profiler);
+				return;
+			}
+
+			const auto& segments = borders.getSegments();
+			uint32_t vertices = 0, flushes = 0;
+
+			// Every border is stored once, so shared edges are not drawn twice
+			rlBegin(RL_LINES);
 
+			for(const auto& block : borders.getBlocks())
+			{
+				if(!CheckCollisionRecs(block.bounds, area)) continue;
+
+				// Blocks fit in a batch, so flushes only ever happen between them
+				if(rlCheckRenderBatchLimit((int)block.count * 2)) flushes++;
+				vertices += block.count * 2;
+
+				for(uint32_t i = block.first; i < block.first + block.count; ++i)
+				{
+					const BorderSegment& segment = segments[i];
+					const Color& color = border_colors[segment.kind];
+
+					rlColor4ub(color.r, color.g, color.b, color.a);
+					rlVertex2f(segment.a.x, segment.a.y);
+					rlVertex2f(segment.b.x, segment.b.y);
 				}
 			}
+
+			rlEnd();
+
+			profiler.addDraw(0, vertices, flushes);
+		}
+
+		// Pick raster texel if it's unambiguous, otherwise only the rings whose grid cell contains the point are tested.
+		// First province in load order wins.
+		ProvinceHandle getProvinceHandleAt(Vector2 point) const
+		{
+			return queries.queryPoint(point);
 		}
 
 		Province getProvinceAt(int x, int y)
 		{
-			Vector2 point = {(float)x, (float)y};
+			ProvinceHandle handle = getProvinceHandleAt({(float)x, (float)y});
+			if(handle == INVALID_PROVINCE) return Province{};
 
-			for(const auto& province : provinces)
+			return provinces[handle];
+		}
+
+		// Call once per frame with the cursor's world position, nearly always costs a single ring test
+		ProvinceHandle updateHover(Vector2 point)
+		{
+			hovered = queries.queryHover(point, hovered);
+			return hovered;
+		}
+
+		ProvinceHandle getHovered() const { return hovered; }
+
+		// Outlines one province over the map (inside BeginMode2D)
+		void render_highlight(ProvinceHandle handle, const Color& color)
+		{
+			if(handle >= provinces.size()) return;
+
+			const auto& segments = borders.getSegments();
+			SegmentRange range = borders.getProvinceSegments(handle);
+
+			rlBegin(RL_LINES);
+			rlCheckRenderBatchLimit((int)range.size() * 2);
+			rlColor4ub(color.r, color.g, color.b, color.a);
+
+			for(uint32_t index : range)
 			{
-				for(const auto& polygon : province.polygons)
-				{
-					// Simplified point-in-polygon check
-					bool inside = false;
-					for (size_t i = 0, j = polygon.size() - 1; i < polygon.size(); j = i++) {
-						if (((polygon[i].y > point.y) != (polygon[j].y > point.y)) &&
-							(point.x < (polygon[j].x - polygon[i].x) * (point.y - polygon[i].y) / 
-							(polygon[j].y - polygon[i].y) + polygon[i].x)) {
-							inside = !inside;
-						}
-					}
-					if (inside) {
-						return province;
-					}
-				}
+				rlVertex2f(segments[index].a.x, segments[index].a.y);
+				rlVertex2f(segments[index].b.x, segments[index].b.y);
 			}
 
-			return Province{};
+			rlEnd();
+		}
+
+		// Path through the interior points of its provinces (inside BeginMode2D)
+		void render_path(const Path& path, const Color& color)
+		{
+			if(path.provinces.size() < 2) return;
+
+			rlBegin(RL_LINES);
+			rlCheckRenderBatchLimit((int)(path.provinces.size() - 1) * 2);
+			rlColor4ub(color.r, color.g, color.b, color.a);
+
+			for(size_t i = 1; i < path.provinces.size(); ++i)
+			{
+				const Vector2& a = provinces[path.provinces[i - 1]].interior_point;
+				const Vector2& b = provinces[path.provinces[i]].interior_point;
+				rlVertex2f(a.x, a.y);
+				rlVertex2f(b.x, b.y);
+			}
+
+			rlEnd();
+		}
+
+		// Every front line in one draw (inside BeginMode2D), chained again only where owners or wars changed
+		void render_front_lines(const Camera2D& camera)
+		{
+			if(!front_lines.isUploaded())
+			{
+				front_lines.upload();
+			}
+
+			front_lines.update(borders, ownership.getOwners());
+			front_lines.draw(camera.zoom, &profiler);
 		}
 
+		// Counters of the divisions on screen, one instanced draw (inside BeginMode2D)
+		void render_units(const DivisionSnapshot& divisions, const Camera2D& camera)
+		{
+			if(!unit_counters.isUploaded())
+			{
+				unit_counters.upload();
+			}
+
+			{
+				ProfileScope scope(&profiler, FRAME_STAGE_CULL);
+				unit_counters.update(divisions, provinces, province_grid, ownership.getCountries(), getViewRect(camera), camera.zoom);
+			}
+
+			unit_counters.draw(camera.zoom, &profiler);
+		}
+
+		const ProvinceGraph& getProvinceGraph() const { return graph; }
+		Pathfinder& getPathfinder() { return pathfinder; }
+		const SpatialGrid& getProvinceGrid() const { return province_grid; }
+		ProvinceQueries& getQueries() { return queries; }
+
+		// Resolution is in texels along the longer side of the map, memory is 4 bytes per texel
+		void setPickRasterEnabled(bool enabled, int resolution = PickRaster::DEFAULT_RESOLUTION)
+		{
+			if(enabled) pick_raster.build(provinces, province_grid.getArea(), resolution, jobs);
+			else pick_raster.clear();
+		}
+
+		const PickRaster& getPickRaster() const { return pick_raster; }
+
 		void setProvinceColor(const string& id, const Color& color)
 		{
-			for(auto& province : provinces)
+			for(ProvinceHandle handle = 0; handle < provinces.size(); ++handle)
 			{
+				Province& province = provinces[handle];
 				if(province.id == id)
 				{
 					province.color = color;
+					map_modes.setProvinceColor(handle, color);
+					map_cache.invalidate();
+
+					for(const auto& bounds : province.polygon_bounds)
+					{
+						tiles.markStale(bounds);
+					}
 					return;
 				}
 			}
 		}
 
+		const Ownership& getOwnership() const { return ownership; }
+		CountryId getOwner(ProvinceHandle handle) const { return ownership.getOwner(handle); }
+
+		// Recolours the country's provinces in the palette and its mesh
+		void setCountryColor(CountryId id, const Color& color)
+		{
+			if(id >= ownership.getCountryCount()) return;
+
+			ownership.setCountryColor(id, color);
+			countries.setCountryColor(id, color);
+
+			ownership.collectProvinces(id, transfer_scratch);
+			for(ProvinceHandle handle : transfer_scratch) map_modes.setProvinceColor(handle, color);
+
+			map_cache.invalidate();
+			tiles.markAllStale();
+		}
+
+		bool isAtWar(CountryId a, CountryId b) const { return front_lines.isAtWar(a, b); }
+
+		// Front lines appear along every border between the two while the war lasts
+		void setWar(CountryId a, CountryId b, bool war)
+		{
+			if(a >= ownership.getCountryCount() || b >= ownership.getCountryCount()) return;
+
+			front_lines.setWar(a, b, war, borders, ownership);
+		}
+
+		// Catches up with the simulation snapshot's owner array, one transfer batch per new owner. The simulation
+		// owns the owners, so this is the only way provinces change hands here (post a SimCommand to move them).
+		size_t applyOwners(const vector<CountryId>& owners)
+		{
+			if(owners.size() != provinces.size()) return 0;
+
+			owner_sync.clear();
+			for(ProvinceHandle handle = 0; handle < owners.size(); ++handle)
+			{
+				if(owners[handle] != ownership.getOwner(handle)) owner_sync.push_back(((uint64_t)owners[handle] << 32) | handle);
+			}
+			sort(owner_sync.begin(), owner_sync.end());
+
+			size_t moved = 0;
+			for(size_t first = 0; first < owner_sync.size();)
+			{
+				CountryId country = (CountryId)(owner_sync[first] >> 32);
+
+				transfer_scratch.clear();
+				size_t last = first;
+				for(; last < owner_sync.size() && (CountryId)(owner_sync[last] >> 32) == country; ++last)
+				{
+					transfer_scratch.push_back((ProvinceHandle)owner_sync[last]);
+				}
+
+				moved += transferProvinces(transfer_scratch.data(), transfer_scratch.size(), country);
+				first = last;
+			}
+			return moved;
+		}
+
+		ProvinceHandle getProvinceHandle(const string& id) const
+		{
+			for(ProvinceHandle handle = 0; handle < provinces.size(); ++handle)
+			{
+				if(provinces[handle].id == id) return handle;
+			}
+
+			return INVALID_PROVINCE;
+		}
+
 		Province getProvinceByID(const string& id)
 		{
 			for(const auto& province : provinces)
@@ -0,0 +1,634 @@
+#pragma once
+
+#include "province.hpp"
+#include "ownership.hpp"
+#include "rlgl.h"
+#include "raymath.h"
+#include <unordered_map>
+#include <algorithm>
+#include <iostream>
+#include <cmath>
+
+#define MAPLABELS_ERR "LakyStrategy::MapLabels::Error: "
+
+// Smooth edges from the distance field at any scale (same as raylib's SDF font example)
+static const char* LABEL_SDF_FS = R"(
+#version 330
+
+in vec2 fragTexCoord;
+in vec4 fragColor;
+
+uniform sampler2D texture0;
+
+out vec4 finalColor;
+
+void main()
+{
+	float distance = texture(texture0, fragTexCoord).a - 0.5;
+	float width = length(vec2(dFdx(distance), dFdy(distance)));
+	float alpha = smoothstep(-width, width, distance);
+
+	finalColor = vec4(fragColor.rgb, fragColor.a * alpha);
+}
+)";
+
+// A piece of text that can be placed on the map
+struct LabelCandidate
+{
+	Vector2 anchor;			// World space, the label is centred on it
+	float world_size;		// Font size in world units, scaled by the camera zoom
+	float min_zoom;			// Hidden below / above these zooms
+	float max_zoom;
+	Color color;
+
+	uint32_t first_glyph;	// Into MapLabels::glyphs
+	uint32_t glyph_count;
+	float width;			// At the font's base size
+};
+
+// Labels of a lower tier are placed first and win collisions, whatever their size
+enum LabelTier
+{
+	LABEL_TIER_COUNTRY = 0,
+	LABEL_TIER_PROVINCE
+};
+
+// One glyph of a laid out label, positioned at the font's base size
+struct LabelGlyph
+{
+	int index;
+	float x;
+};
+
+// Province and country names drawn from one glyph atlas in a single batch, thinned every frame with a
+// screen space collision grid so they never overlap. Province labels are found through a world space grid of
+// their anchors, so a frame only looks at the ones near the view.
+class MapLabels
+{
+	public:
+		static constexpr int FONT_SIZE = 32;			// Atlas glyph size
+		static constexpr int GRID_CELL = 32;			// Collision grid cell, in pixels
+		static constexpr float MIN_PIXEL_SIZE = 9.0f;	// Smaller labels aren't drawn at all
+		static constexpr float MAX_PIXEL_SIZE = 28.0f;
+		static constexpr int DEFAULT_SDF_SCALE = 4;		// Upscale of raylib's default font for its SDF atlas
+		static constexpr int DEFAULT_SDF_SPREAD = 4;		// Pixels of distance field around its glyphs
+		static constexpr float ANCHORS_PER_CELL = 4.0f;	// Target average of the anchor grid, decides the cell size
+
+		bool isReady() const { return ready; }
+
+		// Loads the atlas (SDF from the TTF if there is one, otherwise generated from raylib's default font) and
+		// lays out every label
+		void init(const vector<Province>& provinces, const Ownership& ownership, const string& fontPath)
+		{
+			loadFont(fontPath);
+			build(provinces, ownership);
+			ready = true;
+		}
+
+		// Must be called while the GL context is still alive
+		void unload()
+		{
+			if(!ready) return;
+
+			if(sdf)
+			{
+				UnloadFont(font);
+				UnloadShader(shader);
+			}
+			ready = false;
+		}
+
+		// Lays out every label
+		void build(const vector<Province>& provinces, const Ownership& ownership)
+		{
+			candidates.clear();
+			glyphs.clear();
+			country_labels.clear();
+			country_label_count = 0;
+
+			for(const auto& province : provinces)
+			{
+				if(province.area <= 0.0f) continue;
+
+				const string& text = province.name.empty() ? province.id : province.name;
+				candidates.push_back(layout(text, province.interior_point, sqrtf(province.area) * 0.12f, 0.0f, 1e9f, { 50, 50, 50, 255 }, LABEL_TIER_PROVINCE, province.area, INVALID_COUNTRY));
+			}
+			sort(candidates.begin(), candidates.end(), rankedBefore);
+			buildAnchorGrid();
+
+			// Countries go in front of the provinces so they win collisions
+			dirty_countries.clear();
+			country_dirty.assign(ownership.getCountryCount(), 0);
+			for(CountryId id = 0; id < ownership.getCountryCount(); ++id) markCountryDirty(id);
+			updateCountries(provinces, ownership);
+		}
+
+		// The country's label is placed again by the next updateCountries
+		void markCountryDirty(CountryId id)
+		{
+			if(id == INVALID_COUNTRY) return;
+			if(id >= country_dirty.size()) country_dirty.resize((size_t)id + 1, 0);
+			if(country_dirty[id]) return;
+
+			country_dirty[id] = 1;
+			dirty_countries.push_back(id);
+		}
+
+		// Moves and resizes the labels of the dirty countries, with one pass over the provinces for all of them.
+		// Only countries that had no label yet lay out their text, the province labels are left alone.
+		void updateCountries(const vector<Province>& provinces, const Ownership& ownership)
+		{
+			if(dirty_countries.empty()) return;
+
+			const vector<CountryId>& owners = ownership.getOwners();
+			if(placements.size() < country_dirty.size()) placements.resize(country_dirty.size());
+			for(CountryId id : dirty_countries) placements[id] = { 0.0f, {0, 0}, {0, 0}, 1e30f };
+
+			auto dirtyOwner = [&](ProvinceHandle handle)
+			{
+				return owners[handle] < country_dirty.size() && country_dirty[owners[handle]] && provinces[handle].area > 0.0f;
+			};
+
+			for(ProvinceHandle handle = 0; handle < provinces.size(); ++handle)
+			{
+				if(!dirtyOwner(handle)) continue;
+
+				const Province& province = provinces[handle];
+				CountryPlacement& placement = placements[owners[handle]];
+				placement.area += province.area;
+				placement.centroid.x += province.interior_point.x * province.area;
+				placement.centroid.y += province.interior_point.y * province.area;
+			}
+
+			for(CountryId id : dirty_countries)
+			{
+				CountryPlacement& placement = placements[id];
+				if(placement.area <= 0.0f) continue;
+
+				placement.centroid.x /= placement.area;
+				placement.centroid.y /= placement.area;
+			}
+
+			// The weighted centre can fall outside (bays, crescents), so snap to the nearest member's anchor
+			for(ProvinceHandle handle = 0; handle < provinces.size(); ++handle)
+			{
+				if(!dirtyOwner(handle)) continue;
+
+				CountryPlacement& placement = placements[owners[handle]];
+				Vector2 p = provinces[handle].interior_point;
+				float d = (p.x - placement.centroid.x) * (p.x - placement.centroid.x) + (p.y - placement.centroid.y) * (p.y - placement.centroid.y);
+				if(d < placement.nearest)
+				{
+					placement.nearest = d;
+					placement.anchor = p;
+				}
+			}
+
+			vector<Ranked> added;
+			for(CountryId id : dirty_countries)
+			{
+				country_dirty[id] = 0;
+				if(id >= country_labels.size()) country_labels.resize((size_t)id + 1, NO_LABEL);
+
+				if(country_labels[id] != NO_LABEL)
+				{
+					placeCountry(candidates[country_labels[id]], placements[id]);
+				}
+				else if(placements[id].area > 0.0f && !ownership.getCountry(id).code.empty())
+				{
+					added.push_back(layout(ownership.getCountry(id).code, {0, 0}, 0.0f, 0.0f, 2.0f, { 20, 20, 20, 230 }, LABEL_TIER_COUNTRY, 0.0f, id));
+					placeCountry(added.back(), placements[id]);
+				}
+			}
+			dirty_countries.clear();
+
+			candidates.insert(candidates.begin() + country_label_count, added.begin(), added.end());
+			country_label_count += (uint32_t)added.size();
+
+			// Only the countries are ranked again, the provinces behind them keep their order
+			sort(candidates.begin(), candidates.begin() + country_label_count, rankedBefore);
+			for(uint32_t index = 0; index < country_label_count; ++index) country_labels[candidates[index].country] = index;
+		}
+
+		// Picks the labels that fit this frame and draws them in one batch (screen space, outside BeginMode2D)
+		void render(const Camera2D& camera, int screen_width, int screen_height)
+		{
+			if(!ready) return;
+
+			int grid_w = screen_width / GRID_CELL + 1;
+			int grid_h = screen_height / GRID_CELL + 1;
+			if((int)grid.size() != grid_w * grid_h) grid.assign(grid_w * grid_h, {});
+			for(auto& cell : grid) cell.clear();
+			placed.clear();
+
+			Rectangle screen = {0, 0, (float)screen_width, (float)screen_height};
+			Matrix to_screen = GetCameraMatrix2D(camera);
+
+			auto tryLabel = [&](const LabelCandidate& label)
+			{
+				if(camera.zoom < label.min_zoom || camera.zoom > label.max_zoom) return;
+
+				float size = label.world_size * camera.zoom;
+				if(size < MIN_PIXEL_SIZE) return;
+				size = min(size, MAX_PIXEL_SIZE);
+
+				float scale = size / font.baseSize;
+				float width = label.width * scale;
+
+				Vector2 centre = Vector2Transform(label.anchor, to_screen);
+				Rectangle rect = { centre.x - width / 2, centre.y - size / 2, width, size };
+
+				if(!CheckCollisionRecs(rect, screen)) return;
+				if(!tryPlace(rect, grid_w, grid_h)) return;
+
+				placed.push_back({&label, rect, scale});
+			};
+
+			for(uint32_t index = 0; index < country_label_count; ++index) tryLabel(candidates[index].label);
+
+			// Province labels are sorted by size, so the ones big enough to show are a prefix of them
+			const Ranked* provinces_first = candidates.data() + country_label_count;
+			const Ranked* provinces_last = candidates.data() + candidates.size();
+			uint32_t shown = (uint32_t)(partition_point(provinces_first, provinces_last, [&](const Ranked& ranked)
+			{
+				return ranked.label.world_size * camera.zoom >= MIN_PIXEL_SIZE;
+			}) - provinces_first);
+
+			// Anchors near the view only. A label reaches at most half its widest possible size past its anchor.
+			float margin_x = max_province_width * MAX_PIXEL_SIZE / font.baseSize * 0.5f / camera.zoom;
+			float margin_y = MAX_PIXEL_SIZE * 0.5f / camera.zoom;
+			Rectangle view = getWorldRect(camera, screen);
+			view = { view.x - margin_x, view.y - margin_y, view.width + 2 * margin_x, view.height + 2 * margin_y };
+
+			queryAnchors(view, shown, visible_provinces);
+			for(uint32_t province : visible_provinces) tryLabel(provinces_first[province].label);
+
+			if(placed.empty()) return;
+
+			if(sdf) BeginShaderMode(shader);
+
+			rlSetTexture(font.texture.id);
+			rlBegin(RL_QUADS);
+
+			for(const auto& item : placed)
+			{
+				const LabelCandidate& label = *item.label;
+				rlCheckRenderBatchLimit((int)label.glyph_count * 4);
+				rlColor4ub(label.color.r, label.color.g, label.color.b, label.color.a);
+
+				for(uint32_t g = label.first_glyph; g < label.first_glyph + label.glyph_count; ++g)
+				{
+					emitGlyph(glyphs[g], item.rect.x, item.rect.y, item.scale);
+				}
+			}
+
+			rlEnd();
+			rlSetTexture(0);
+
+			if(sdf) EndShaderMode();
+		}
+
+		size_t getCandidateCount() const { return candidates.size(); }
+		size_t getVisitedCount() const { return country_label_count + visible_provinces.size(); }
+		size_t getPlacedCount() const { return placed.size(); }
+
+	private:
+		struct Ranked
+		{
+			LabelCandidate label;
+			LabelTier tier;
+			float priority;		// Within the tier, larger first
+			CountryId country;	// Whose name it is, for country labels
+		};
+
+		// Where a country's label goes, gathered from its provinces
+		struct CountryPlacement
+		{
+			float area;
+			Vector2 centroid;
+			Vector2 anchor;
+			float nearest;		// Squared distance of the anchor to the centroid
+		};
+
+		static constexpr uint32_t NO_LABEL = UINT32_MAX;
+
+		struct Placed
+		{
+			const LabelCandidate* label;
+			Rectangle rect;
+			float scale;
+		};
+
+		Font font = {};
+		Shader shader = {};
+		bool sdf = false;
+		bool ready = false;
+
+		vector<Ranked> candidates;		// Countries first, then provinces
+		vector<LabelGlyph> glyphs;
+
+		// Per CountryId: its label's index in candidates, and whether it waits for updateCountries
+		vector<uint32_t> country_labels;
+		uint32_t country_label_count = 0;
+		vector<uint8_t> country_dirty;
+		vector<CountryId> dirty_countries;
+		vector<CountryPlacement> placements;
+
+		vector<vector<uint32_t>> grid;	// Indices into placed, per collision cell
+		vector<Placed> placed;
+
+		// Province label anchors in a uniform world space grid (CSR, ascending label order in every cell).
+		// Indices count from the first province label, those don't move when countries are added.
+		Rectangle anchor_area = {0, 0, 0, 0};
+		float anchor_cell = 1.0f;
+		int anchor_cols = 0, anchor_rows = 0;
+		vector<uint32_t> anchor_cell_start;
+		vector<uint32_t> anchor_items;
+		float max_province_width = 0.0f;	// At the font's base size
+		vector<uint32_t> visible_provinces;
+
+		float letter_spacing = 1.0f;		// At the font's base size
+
+		void loadFont(const string& fontPath)
+		{
+			// Latin, Latin-1 and Latin Extended A/B cover the region names
+			vector<int> codepoints;
+			for(int c = 32; c < 127; ++c) codepoints.push_back(c);
+			for(int c = 160; c < 592; ++c) codepoints.push_back(c);
+
+			int size = 0;
+			unsigned char* data = FileExists(fontPath.c_str()) ? LoadFileData(fontPath.c_str(), &size) : nullptr;
+
+			if(data)
+			{
+				font.baseSize = FONT_SIZE;
+				font.glyphCount = (int)codepoints.size();
+				font.glyphs = LoadFontData(data, size, FONT_SIZE, codepoints.data(), (int)codepoints.size(), FONT_SDF);
+				UnloadFileData(data);
+
+				if(!font.glyphs) cerr << MAPLABELS_ERR << "Failed to load SDF font from " << fontPath << ", using the default font" << endl;
+			}
+
+			if(!data || !font.glyphs) buildDefaultSdf();
+
+			Image atlas = GenImageFontAtlas(font.glyphs, &font.recs, font.glyphCount, font.baseSize, 0, 1);
+			font.texture = LoadTextureFromImage(atlas);
+			UnloadImage(atlas);
+			SetTextureFilter(font.texture, TEXTURE_FILTER_BILINEAR);
+
+			shader = LoadShaderFromMemory(0, LABEL_SDF_FS);
+			sdf = true;
+		}
+
+		// The same kind of glyphs LoadFontData makes with FONT_SDF (grayscale, 128 on the outline), from raylib's
+		// built in font so labels scale smoothly without any font file. Its pixels are upscaled first, the
+		// distance field then rounds their corners a little.
+		void buildDefaultSdf()
+		{
+			const Font& base = GetFontDefault();
+			const int scale = DEFAULT_SDF_SCALE, spread = DEFAULT_SDF_SPREAD;
+
+			font = {};
+			font.baseSize = base.baseSize * scale;
+			font.glyphCount = base.glyphCount;
+			font.glyphs = (GlyphInfo*)MemAlloc(sizeof(GlyphInfo) * base.glyphCount);
+			letter_spacing = (float)scale;
+
+			vector<uint8_t> inside;
+			for(int i = 0; i < base.glyphCount; ++i)
+			{
+				const GlyphInfo& source = base.glyphs[i];
+				int source_w = (int)base.recs[i].width, source_h = (int)base.recs[i].height;
+				int w = source_w * scale + 2 * spread, h = source_h * scale + 2 * spread;
+
+				inside.assign((size_t)w * h, 0);
+				for(int y = 0; y < source_h * scale; ++y)
+				{
+					for(int x = 0; x < source_w * scale; ++x)
+					{
+						inside[(size_t)(y + spread) * w + x + spread] = GetImageColor(source.image, x / scale, y / scale).a > 127;
+					}
+				}
+
+				GlyphInfo& glyph = font.glyphs[i];
+				glyph.value = source.value;
+				glyph.offsetX = source.offsetX * scale - spread;
+				glyph.offsetY = source.offsetY * scale - spread;
+				glyph.advanceX = (source.advanceX != 0 ? source.advanceX : source_w) * scale;
+
+				unsigned char* pixels = (unsigned char*)MemAlloc(w * h);
+				for(int y = 0; y < h; ++y)
+				{
+					for(int x = 0; x < w; ++x)
+					{
+						bool in = inside[(size_t)y * w + x];
+
+						// Nearest pixel on the other side of the outline, within the spread
+						int best = (spread + 1) * (spread + 1);
+						for(int dy = -spread; dy <= spread; ++dy)
+						{
+							int sy = y + dy;
+							if(sy < 0 || sy >= h) { if(in) best = min(best, dy * dy); continue; }
+
+							for(int dx = -spread; dx <= spread; ++dx)
+							{
+								int sx = x + dx;
+								bool other = sx < 0 || sx >= w ? false : inside[(size_t)sy * w + sx];
+								if(other != in) best = min(best, dx * dx + dy * dy);
+							}
+						}
+
+						float distance = sqrtf((float)best) - 0.5f;
+						float value = 0.5f + (in ? distance : -distance) / (2.0f * spread);
+						pixels[y * w + x] = (unsigned char)(Clamp(value, 0.0f, 1.0f) * 255.0f);
+					}
+				}
+
+				glyph.image = { pixels, w, h, 1, PIXELFORMAT_UNCOMPRESSED_GRAYSCALE };
+			}
+		}
+
+		// Visible part of the world, the bounds of the screen corners
+		static Rectangle getWorldRect(const Camera2D& camera, const Rectangle& screen)
+		{
+			Vector2 corners[4] = {
+				GetScreenToWorld2D({screen.x, screen.y}, camera),
+				GetScreenToWorld2D({screen.x + screen.width, screen.y}, camera),
+				GetScreenToWorld2D({screen.x, screen.y + screen.height}, camera),
+				GetScreenToWorld2D({screen.x + screen.width, screen.y + screen.height}, camera)
+			};
+
+			Vector2 lo = corners[0], hi = corners[0];
+			for(const Vector2& corner : corners)
+			{
+				lo = { min(lo.x, corner.x), min(lo.y, corner.y) };
+				hi = { max(hi.x, corner.x), max(hi.y, corner.y) };
+			}
+			return { lo.x, lo.y, hi.x - lo.x, hi.y - lo.y };
+		}
+
+		// Over the province labels, which directly follow the country labels in candidates
+		void buildAnchorGrid()
+		{
+			const Ranked* first = candidates.data() + country_label_count;
+			uint32_t count = (uint32_t)(candidates.size() - country_label_count);
+
+			max_province_width = 0.0f;
+			anchor_cols = anchor_rows = 0;
+			anchor_cell_start.assign(1, 0);
+			anchor_items.clear();
+			if(count == 0) return;
+
+			Vector2 lo = first[0].label.anchor, hi = lo;
+			for(uint32_t i = 0; i < count; ++i)
+			{
+				const LabelCandidate& label = first[i].label;
+				lo = { min(lo.x, label.anchor.x), min(lo.y, label.anchor.y) };
+				hi = { max(hi.x, label.anchor.x), max(hi.y, label.anchor.y) };
+				max_province_width = max(max_province_width, label.width);
+			}
+
+			anchor_area = { lo.x, lo.y, max(hi.x - lo.x, 1e-3f), max(hi.y - lo.y, 1e-3f) };
+			anchor_cell = sqrtf(anchor_area.width * anchor_area.height * ANCHORS_PER_CELL / count);
+			anchor_cols = max(1, (int)ceilf(anchor_area.width / anchor_cell));
+			anchor_rows = max(1, (int)ceilf(anchor_area.height / anchor_cell));
+
+			// Count, prefix sum, fill in label order
+			anchor_cell_start.assign((size_t)anchor_cols * anchor_rows + 1, 0);
+			for(uint32_t i = 0; i < count; ++i) anchor_cell_start[anchorCell(first[i].label.anchor) + 1]++;
+			for(size_t c = 1; c < anchor_cell_start.size(); ++c) anchor_cell_start[c] += anchor_cell_start[c - 1];
+
+			anchor_items.resize(count);
+			vector<uint32_t> cursor(anchor_cell_start.begin(), anchor_cell_start.end() - 1);
+			for(uint32_t i = 0; i < count; ++i) anchor_items[cursor[anchorCell(first[i].label.anchor)]++] = i;
+		}
+
+		size_t anchorCell(Vector2 p) const
+		{
+			int x = min(max((int)((p.x - anchor_area.x) / anchor_cell), 0), anchor_cols - 1);
+			int y = min(max((int)((p.y - anchor_area.y) / anchor_cell), 0), anchor_rows - 1);
+			return (size_t)y * anchor_cols + x;
+		}
+
+		// Province labels below `limit` with their anchor in the area, in label order
+		void queryAnchors(const Rectangle& area, uint32_t limit, vector<uint32_t>& out) const
+		{
+			out.clear();
+			if(anchor_cols == 0 || limit == 0) return;
+
+			int x0 = max((int)floorf((area.x - anchor_area.x) / anchor_cell), 0);
+			int y0 = max((int)floorf((area.y - anchor_area.y) / anchor_cell), 0);
+			int x1 = min((int)floorf((area.x + area.width - anchor_area.x) / anchor_cell), anchor_cols - 1);
+			int y1 = min((int)floorf((area.y + area.height - anchor_area.y) / anchor_cell), anchor_rows - 1);
+
+			for(int y = y0; y <= y1; ++y)
+			{
+				for(int x = x0; x <= x1; ++x)
+				{
+					size_t cell = (size_t)y * anchor_cols + x;
+					for(uint32_t i = anchor_cell_start[cell]; i < anchor_cell_start[cell + 1]; ++i)
+					{
+						if(anchor_items[i] < limit) out.push_back(anchor_items[i]);
+					}
+				}
+			}
+
+			sort(out.begin(), out.end());
+		}
+
+		static bool rankedBefore(const Ranked& a, const Ranked& b)
+		{
+			return a.tier != b.tier ? a.tier < b.tier : a.priority > b.priority;
+		}
+
+		// A country without provinces keeps its label, too small to ever be drawn
+		static void placeCountry(Ranked& ranked, const CountryPlacement& placement)
+		{
+			ranked.label.anchor = placement.anchor;
+			ranked.label.world_size = sqrtf(placement.area) * 0.25f;
+			ranked.priority = placement.area;
+		}
+
+		Ranked layout(const string& text, Vector2 anchor, float world_size, float min_zoom, float max_zoom, Color color, LabelTier tier, float priority, CountryId country)
+		{
+			LabelCandidate label;
+			label.anchor = anchor;
+			label.world_size = world_size;
+			label.min_zoom = min_zoom;
+			label.max_zoom = max_zoom;
+			label.color = color;
+			label.first_glyph = (uint32_t)glyphs.size();
+
+			// Lay the text out once at the base size, frames only scale and move it
+			float x = 0.0f;
+			const char* cursor = text.c_str();
+			while(*cursor)
+			{
+				int bytes = 0;
+				int codepoint = GetCodepointNext(cursor, &bytes);
+				cursor += max(bytes, 1);
+
+				int index = GetGlyphIndex(font, codepoint);
+				glyphs.push_back({index, x});
+
+				x += font.glyphs[index].advanceX != 0 ? (float)font.glyphs[index].advanceX : font.recs[index].width;
+				x += letter_spacing;
+			}
+
+			label.glyph_count = (uint32_t)glyphs.size() - label.first_glyph;
+			label.width = x;
+
+			return {label, tier, priority, country};
+		}
+
+		bool tryPlace(const Rectangle& rect, int grid_w, int grid_h)
+		{
+			int x0 = max(0, (int)(rect.x / GRID_CELL));
+			int y0 = max(0, (int)(rect.y / GRID_CELL));
+			int x1 = min(grid_w - 1, (int)((rect.x + rect.width) / GRID_CELL));
+			int y1 = min(grid_h - 1, (int)((rect.y + rect.height) / GRID_CELL));
+
+			for(int y = y0; y <= y1; ++y)
+			{
+				for(int x = x0; x <= x1; ++x)
+				{
+					for(uint32_t other : grid[y * grid_w + x])
+					{
+						if(CheckCollisionRecs(rect, placed[other].rect)) return false;
+					}
+				}
+			}
+
+			for(int y = y0; y <= y1; ++y)
+			{
+				for(int x = x0; x <= x1; ++x)
+				{
+					grid[y * grid_w + x].push_back((uint32_t)placed.size());
+				}
+			}
+
+			return true;
+		}
+
+		// Same quad as raylib's DrawTextCodepoint, straight into the open batch
+		void emitGlyph(const LabelGlyph& glyph, float x, float y, float scale)
+		{
+			const GlyphInfo& info = font.glyphs[glyph.index];
+			const Rectangle& src = font.recs[glyph.index];
+			float padding = (float)font.glyphPadding;
+
+			float left = x + glyph.x * scale + (info.offsetX - padding) * scale;
+			float top = y + (info.offsetY - padding) * scale;
+			float right = left + (src.width + 2.0f * padding) * scale;
+			float bottom = top + (src.height + 2.0f * padding) * scale;
+
+			float tw = (float)font.texture.width, th = (float)font.texture.height;
+			float u0 = (src.x - padding) / tw, v0 = (src.y - padding) / th;
+			float u1 = (src.x + src.width + padding) / tw, v1 = (src.y + src.height + padding) / th;
+
+			rlTexCoord2f(u0, v0); rlVertex2f(left, top);
+			rlTexCoord2f(u0, v1); rlVertex2f(left, bottom);
+			rlTexCoord2f(u1, v1); rlVertex2f(right, bottom);
+			rlTexCoord2f(u1, v0); rlVertex2f(right, top);
+		}
+};
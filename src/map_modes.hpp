@@ -0,0 +1,225 @@
+#pragma once
+
+#include "province.hpp"
+#include "rlgl.h"
+#include <cmath>
+#include <climits>
+#include <algorithm>
+#include <iostream>
+
+#define MAPMODES_ERR "LakyStrategy::MapModes::Error: "
+
+enum MapMode
+{
+	MAP_MODE_POLITICAL = 0,
+	MAP_MODE_TERRAIN,
+	MAP_MODE_URBANISATION,
+	MAP_MODE_COASTAL,
+
+	MAP_MODE_COUNT
+};
+
+static const char* MAP_MODE_NAMES[MAP_MODE_COUNT] = { "Political", "Terrain", "Urbanisation", "Coastal" };
+
+// Every province has two texels in the data texture: its colour, then its NUTS attributes.
+// The fragment shader picks what to show, so switching modes needs no per-province work on the CPU.
+static const char* MAP_MODES_FS = R"(
+#version 330
+
+in vec2 fragTexCoord;
+in vec4 fragColor;
+
+uniform sampler2D texture0;		// Province data texture
+uniform int mode;
+
+out vec4 finalColor;
+
+// NUTS typologies are small categories, 0 means no data
+vec3 terrain(float mount)
+{
+	if(mount < 0.5) return vec3(0.55);
+	if(mount > 3.5) return vec3(0.55, 0.75, 0.40);				// Not a mountain region
+	return mix(vec3(0.95, 0.95, 0.95), vec3(0.55, 0.40, 0.25), (mount - 1.0) / 2.0);	// 1 = most mountainous
+}
+
+vec3 urbanisation(float urban)
+{
+	if(urban < 0.5) return vec3(0.55);
+	return mix(vec3(0.85, 0.20, 0.15), vec3(0.95, 0.90, 0.60), (urban - 1.0) / 2.0);	// 1 = predominantly urban
+}
+
+vec3 coastal(float coast)
+{
+	if(coast < 0.5) return vec3(0.55);
+	return mix(vec3(0.15, 0.45, 0.85), vec3(0.90, 0.85, 0.70), (coast - 1.0) / 2.0);	// 1 = coastal
+}
+
+void main()
+{
+	ivec2 texel = ivec2(fragTexCoord * vec2(textureSize(texture0, 0)));
+
+	vec4 color = texelFetch(texture0, texel, 0);
+	vec3 attributes = texelFetch(texture0, texel + ivec2(1, 0), 0).rgb * 255.0;
+
+	vec3 rgb = color.rgb;
+	if(mode == 1) rgb = terrain(attributes.r);
+	else if(mode == 2) rgb = urbanisation(attributes.g);
+	else if(mode == 3) rgb = coastal(attributes.b);
+
+	finalColor = vec4(rgb, color.a);
+}
+)";
+
+// Province colours and attributes on the GPU, plus the shader that turns them into the map modes
+class MapModes
+{
+	public:
+		static constexpr int TEXTURE_WIDTH = 512;	// Texels, two per province
+		static constexpr int PROVINCES_PER_ROW = TEXTURE_WIDTH / 2;
+
+		// CPU side data, done at load time
+		void build(const vector<Province>& provinces)
+		{
+			int rows = max(1, (int)((provinces.size() + PROVINCES_PER_ROW - 1) / PROVINCES_PER_ROW));
+			height = rows;
+
+			data.assign(TEXTURE_WIDTH * rows, Color{0, 0, 0, 0});
+			texcoords.resize(provinces.size());
+
+			for(ProvinceHandle handle = 0; handle < provinces.size(); ++handle)
+			{
+				const Province& province = provinces[handle];
+
+				data[texelIndex(handle)] = province.color;
+				data[texelIndex(handle) + 1] = {
+					category(province.mountain_type),
+					category(province.urban_type),
+					category(province.coast_type),
+					255
+				};
+
+				// Centre of the colour texel
+				texcoords[handle] = {
+					(2 * (handle % PROVINCES_PER_ROW) + 0.5f) / TEXTURE_WIDTH,
+					(handle / PROVINCES_PER_ROW + 0.5f) / rows
+				};
+			}
+		}
+
+		// GPU side, needs the GL context
+		void upload()
+		{
+			Image image = { data.data(), TEXTURE_WIDTH, height, 1, PIXELFORMAT_UNCOMPRESSED_R8G8B8A8 };
+			texture = LoadTextureFromImage(image);
+			SetTextureFilter(texture, TEXTURE_FILTER_POINT);
+
+			shader = LoadShaderFromMemory(0, MAP_MODES_FS);
+			shader_ok = shader.id != 0 && shader.id != rlGetShaderIdDefault();
+			if(!shader_ok)
+			{
+				cerr << MAPMODES_ERR << "Failed to compile the map mode shader, only the political map is available" << endl;
+			}
+
+			mode_loc = GetShaderLocation(shader, "mode");
+			applyMode();
+
+			// The whole image went up, nothing left to flush
+			dirty_first_row = INT_MAX;
+			dirty_last_row = -1;
+
+			uploaded = true;
+		}
+
+		// Must be called while the GL context is still alive
+		void unload()
+		{
+			if(!uploaded) return;
+
+			UnloadTexture(texture);
+			if(shader_ok) UnloadShader(shader);
+			uploaded = false;
+		}
+
+		bool isUploaded() const { return uploaded; }
+
+		MapMode getMode() const { return mode; }
+		void setMode(MapMode new_mode)
+		{
+			mode = new_mode;
+			if(uploaded) applyMode();
+		}
+
+		// Only the one texel changes, uploaded by the next flushColors together with the other changes
+		void setProvinceColor(ProvinceHandle handle, const Color& color)
+		{
+			data[texelIndex(handle)] = color;
+
+			int row = (int)(handle / PROVINCES_PER_ROW);
+			dirty_first_row = min(dirty_first_row, row);
+			dirty_last_row = max(dirty_last_row, row);
+		}
+
+		// One upload for the rows touched since the last flush. Returns true if anything was uploaded.
+		bool flushColors()
+		{
+			if(!uploaded || dirty_first_row > dirty_last_row) return false;
+
+			Rectangle rows = { 0, (float)dirty_first_row, (float)TEXTURE_WIDTH, (float)(dirty_last_row - dirty_first_row + 1) };
+			UpdateTextureRec(texture, rows, &data[(size_t)dirty_first_row * TEXTURE_WIDTH]);
+
+			dirty_first_row = INT_MAX;
+			dirty_last_row = -1;
+			return true;
+		}
+
+		// Where each province's texels are, emitted as the texture coordinate of its vertices
+		const vector<Vector2>& getTexcoords() const { return texcoords; }
+
+		// Binds the data texture and shader around a fill pass, returns false if the vertex colours are used instead
+		bool begin()
+		{
+			if(!uploaded || !shader_ok) return false;
+
+			BeginShaderMode(shader);
+			rlSetTexture(texture.id);
+			return true;
+		}
+
+		void end()
+		{
+			rlSetTexture(0);
+			EndShaderMode();
+		}
+
+	private:
+		vector<Color> data;
+		vector<Vector2> texcoords;
+		int height = 1;
+		int dirty_first_row = INT_MAX, dirty_last_row = -1;
+
+		Texture2D texture = {};
+		Shader shader = {};
+		int mode_loc = -1;
+		bool shader_ok = false;
+		bool uploaded = false;
+
+		MapMode mode = MAP_MODE_POLITICAL;
+
+		static size_t texelIndex(ProvinceHandle handle)
+		{
+			return (size_t)(handle / PROVINCES_PER_ROW) * TEXTURE_WIDTH + 2 * (handle % PROVINCES_PER_ROW);
+		}
+
+		static unsigned char category(float value)
+		{
+			return (unsigned char)max(0.0f, min(255.0f, roundf(value)));
+		}
+
+		void applyMode()
+		{
+			if(!shader_ok) return;
+
+			int value = (int)mode;
+			SetShaderValue(shader, mode_loc, &value, SHADER_UNIFORM_INT);
+		}
+};
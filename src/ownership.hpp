@@ -0,0 +1,131 @@
+#pragma once
+
+#include "province.hpp"
+#include <unordered_map>
+#include <algorithm>
+#include <iostream>
+
+// Index of a country inside Ownership, stable for the lifetime of a loaded map
+typedef uint16_t CountryId;
+
+static constexpr CountryId INVALID_COUNTRY = UINT16_MAX;
+
+struct Country
+{
+	string code;
+	Color color;
+	uint32_t province_count;
+};
+
+// One province that changed hands, as returned by Ownership::transfer
+struct OwnerChange
+{
+	ProvinceHandle province;
+	CountryId from;
+	CountryId to;
+};
+
+// Who owns every province, as a flat array indexed by province handle, plus the country table.
+// Countries start out as the distinct NUTS country codes. Colours live here, not on the provinces.
+class Ownership
+{
+	public:
+		void build(const vector<Province>& provinces)
+		{
+			countries.clear();
+			country_index.clear();
+			owners.resize(provinces.size());
+
+			for(ProvinceHandle handle = 0; handle < provinces.size(); ++handle)
+			{
+				CountryId id = addCountry(provinces[handle].country_code, defaultColor(provinces[handle].country_code));
+				owners[handle] = id;
+				countries[id].province_count++;
+			}
+
+			cout << "Built ownership: " << countries.size() << " countries" << endl;
+		}
+
+		// Existing id if the code is already known
+		CountryId addCountry(const string& code, const Color& color)
+		{
+			auto it = country_index.find(code);
+			if(it != country_index.end()) return it->second;
+
+			if(countries.size() >= INVALID_COUNTRY) return INVALID_COUNTRY;
+
+			CountryId id = (CountryId)countries.size();
+			countries.push_back({code, color, 0});
+			country_index[code] = id;
+			return id;
+		}
+
+		CountryId findCountry(const string& code) const
+		{
+			auto it = country_index.find(code);
+			return it != country_index.end() ? it->second : INVALID_COUNTRY;
+		}
+
+		CountryId getOwner(ProvinceHandle handle) const { return handle < owners.size() ? owners[handle] : INVALID_COUNTRY; }
+		const vector<CountryId>& getOwners() const { return owners; }
+
+		const Country& getCountry(CountryId id) const { return countries[id]; }
+		const vector<Country>& getCountries() const { return countries; }
+		size_t getCountryCount() const { return countries.size(); }
+
+		void setCountryColor(CountryId id, const Color& color) { countries[id].color = color; }
+
+		// Moves provinces to a country, appending the ones that actually changed owner to `changes`.
+		// Returns how many did.
+		size_t transfer(const ProvinceHandle* handles, size_t count, CountryId to, vector<OwnerChange>& changes)
+		{
+			if(to >= countries.size()) return 0;
+
+			size_t changed = 0;
+			for(size_t i = 0; i < count; ++i)
+			{
+				ProvinceHandle handle = handles[i];
+				if(handle >= owners.size() || owners[handle] == to) continue;
+
+				CountryId from = owners[handle];
+				owners[handle] = to;
+				countries[from].province_count--;
+				countries[to].province_count++;
+
+				changes.push_back({handle, from, to});
+				changed++;
+			}
+			return changed;
+		}
+
+		// Every province a country owns, in handle order
+		void collectProvinces(CountryId id, vector<ProvinceHandle>& out) const
+		{
+			out.clear();
+			for(ProvinceHandle handle = 0; handle < owners.size(); ++handle)
+			{
+				if(owners[handle] == id) out.push_back(handle);
+			}
+		}
+
+		static Color defaultColor(const string& code)
+		{
+			int hash = 0;
+			for (char c : code) hash = hash * 31 + c;
+			hash &= 0x7FFFFFFF;
+
+			// Same pastel range as the province colours, a bit more saturated so countries stand apart
+			return {
+				(unsigned char)(150 + (hash % 100)),
+				(unsigned char)(150 + ((hash / 100) % 100)),
+				(unsigned char)(150 + ((hash / 10000) % 100)),
+				200
+			};
+		}
+
+	private:
+		vector<Country> countries;
+		unordered_map<string, CountryId> country_index;
+
+		vector<CountryId> owners;	// Per province handle
+};
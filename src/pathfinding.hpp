@@ -0,0 +1,534 @@
+#pragma once
+
+#include "province.hpp"
+#include "province_graph.hpp"
+#include "ownership.hpp"
+#include "job_system.hpp"
+#include <unordered_map>
+#include <algorithm>
+#include <iostream>
+#include <cmath>
+
+struct PathRequest
+{
+	ProvinceHandle from;
+	ProvinceHandle to;
+};
+
+struct Path
+{
+	vector<ProvinceHandle> provinces;	// Start to goal, both included. Empty if the goal can't be reached.
+	float cost = 0.0f;
+
+	bool found() const { return !provinces.empty(); }
+};
+
+// How requests were answered, accumulated until reset
+struct PathStats
+{
+	uint32_t cache_hits = 0;
+	uint32_t searches = 0;		// Cache misses
+	uint32_t fallbacks = 0;		// Searches whose corridor had no way through, solved over the whole graph
+};
+
+// Movement paths over the province graph. Provinces are clustered by owner: a coarse search over the cluster
+// graph picks the countries to cross, then A* over provinces runs only inside that corridor.
+// Step costs are the distance between interior points scaled by terrain (mountains and cities are slow).
+// Found paths are cached until a country they cross changes (ownership or passability of one of its provinces).
+// Not thread safe, call from one thread at a time. findPaths spreads a batch over the job system itself.
+class Pathfinder
+{
+	public:
+		static constexpr size_t MAX_CACHED_PATHS = 16384;	// The cache starts over when it gets this big
+
+		// Everything it needs is copied, only the graph is referenced (it doesn't change after loading)
+		void build(const vector<Province>& provinces, const ProvinceGraph& province_graph, const vector<CountryId>& owners)
+		{
+			graph = &province_graph;
+
+			positions.resize(provinces.size());
+			factors.resize(provinces.size());
+			passable.assign(provinces.size(), 1);
+			province_cluster.assign(provinces.size(), 0);
+
+			clusters.clear();
+			cache.clear();
+
+			for(ProvinceHandle handle = 0; handle < provinces.size(); ++handle)
+			{
+				positions[handle] = provinces[handle].interior_point;
+				factors[handle] = terrainFactor(provinces[handle]);
+
+				uint32_t cluster = clusterOf(owners[handle]);
+				province_cluster[handle] = cluster;
+				addMember(cluster, handle);
+			}
+
+			for(ProvinceHandle handle = 0; handle < provinces.size(); ++handle)
+			{
+				for(ProvinceHandle neighbour : graph->getNeighbours(handle))
+				{
+					if(province_cluster[neighbour] != province_cluster[handle]) addLink(province_cluster[handle], province_cluster[neighbour], 1);
+				}
+			}
+
+			size_t used = count_if(clusters.begin(), clusters.end(), [](const Cluster& c) { return c.members > 0; });
+			cout << "Built pathfinder: " << used << " clusters" << endl;
+		}
+
+		// Movement cost multiplier, 1 on open flat land. Same NUTS categories as the terrain map modes
+		// (1 = most mountainous / most urban, 4 = not a mountain region, 0 = unknown).
+		static float terrainFactor(const Province& province)
+		{
+			float factor = 1.0f;
+
+			int mountain = (int)lroundf(province.mountain_type);
+			if(mountain >= 1 && mountain <= 3) factor *= 1.0f + (4 - mountain) * 0.35f;
+
+			int urban = (int)lroundf(province.urban_type);
+			if(urban >= 1 && urban <= 3) factor *= 1.0f + (4 - urban) * 0.1f;
+
+			return factor;
+		}
+
+		// Impassable provinces are never entered (they can still be the start of a path)
+		void setPassable(ProvinceHandle handle, bool value)
+		{
+			if(handle >= passable.size() || (passable[handle] != 0) == value) return;
+
+			passable[handle] = value;
+			clusters[province_cluster[handle]].version++;
+		}
+
+		bool isPassable(ProvinceHandle handle) const { return handle < passable.size() && passable[handle]; }
+
+		// Call after a province changed owner, only paths through the two clusters involved are dropped
+		void setOwner(ProvinceHandle handle, CountryId owner)
+		{
+			if(handle >= province_cluster.size()) return;
+
+			uint32_t old_cluster = province_cluster[handle];
+			uint32_t new_cluster = clusterOf(owner);
+			if(new_cluster == old_cluster) return;
+
+			removeMember(old_cluster, handle);
+
+			for(ProvinceHandle neighbour : graph->getNeighbours(handle))
+			{
+				uint32_t other = province_cluster[neighbour];
+				if(other != old_cluster) addLink(old_cluster, other, -1);
+				if(other != new_cluster) addLink(new_cluster, other, 1);
+			}
+			province_cluster[handle] = new_cluster;
+
+			addMember(new_cluster, handle);
+			clusters[old_cluster].version++;
+			clusters[new_cluster].version++;
+		}
+
+		// Call after a province's terrain changed
+		void updateTerrain(ProvinceHandle handle, const Province& province)
+		{
+			if(handle >= province_cluster.size()) return;
+
+			uint32_t cluster = province_cluster[handle];
+			removeMember(cluster, handle);
+			factors[handle] = terrainFactor(province);
+			addMember(cluster, handle);
+
+			clusters[cluster].version++;
+		}
+
+		// Cost of moving between two neighbouring provinces, the same one the searches use
+		float getStepCost(ProvinceHandle from, ProvinceHandle to) const
+		{
+			return distance(positions[from], positions[to]) * 0.5f * (factors[from] + factors[to]);
+		}
+
+		// Clusters are indexed by CountryId
+		uint32_t getCluster(ProvinceHandle handle) const { return handle < province_cluster.size() ? province_cluster[handle] : UINT32_MAX; }
+		size_t getClusterCount() const { return clusters.size(); }
+		size_t getCachedPathCount() const { return cache.size(); }
+
+		void clearCache() { cache.clear(); }
+
+		const PathStats& getStats() const { return stats; }
+		void resetStats() { stats = PathStats(); }
+
+		// One path, from the cache if nothing it crosses has changed. Returns out.found().
+		bool findPath(ProvinceHandle from, ProvinceHandle to, Path& out)
+		{
+			if(lookup(from, to, out)) return true;
+
+			prepareScratch(1);
+			bool fallback = false;
+			solve(from, to, scratch[0], out, fallback);
+
+			stats.searches++;
+			if(fallback) stats.fallbacks++;
+
+			store(from, to, out);
+			return out.found();
+		}
+
+		// Many paths at once (every unit order of a tick). Cache hits are answered first, the rest are solved
+		// in parallel with one search state per worker.
+		void findPaths(const PathRequest* requests, size_t count, Path* out, JobSystem& jobs)
+		{
+			misses.clear();
+			for(size_t i = 0; i < count; ++i)
+			{
+				if(!lookup(requests[i].from, requests[i].to, out[i])) misses.push_back((uint32_t)i);
+			}
+
+			prepareScratch(jobs.getThreadCount());
+			miss_fallbacks.assign(misses.size(), 0);
+
+			jobs.parallelFor(misses.size(), 4, [&](size_t begin, size_t end, unsigned worker)
+			{
+				for(size_t m = begin; m < end; ++m)
+				{
+					const PathRequest& request = requests[misses[m]];
+					bool fallback = false;
+					solve(request.from, request.to, scratch[worker], out[misses[m]], fallback);
+					miss_fallbacks[m] = fallback;
+				}
+			});
+
+			for(size_t m = 0; m < misses.size(); ++m)
+			{
+				const PathRequest& request = requests[misses[m]];
+				store(request.from, request.to, out[misses[m]]);
+
+				stats.searches++;
+				if(miss_fallbacks[m]) stats.fallbacks++;
+			}
+		}
+
+	private:
+		struct ClusterLink
+		{
+			uint32_t cluster;
+			uint32_t count;		// Province adjacencies between the two clusters
+		};
+
+		struct Cluster
+		{
+			uint32_t members = 0;
+			float sum_x = 0.0f, sum_y = 0.0f;	// Of member interior points, for the centroid
+			float factor_sum = 0.0f;
+			uint32_t version = 0;				// Bumped whenever a member changes
+			vector<ClusterLink> links;
+		};
+
+		struct CachedPath
+		{
+			Path path;
+			vector<pair<uint32_t, uint32_t>> clusters;	// Every cluster the path crosses with its version at the time
+		};
+
+		// Per worker A* state. Arrays are indexed by province and only valid where the stamp matches the search.
+		struct SearchScratch
+		{
+			vector<float> g;
+			vector<ProvinceHandle> parent;
+			vector<uint32_t> seen;			// Search generation that last reached the province
+			vector<uint32_t> closed;		// Search generation that expanded it
+			vector<uint32_t> allowed;		// Search generation that allows the cluster
+			vector<pair<float, uint32_t>> open;
+			uint32_t generation = 0;
+
+			// Cluster level search
+			vector<float> cluster_g;
+			vector<uint32_t> cluster_parent;
+			vector<uint32_t> cluster_seen;
+			vector<uint32_t> cluster_closed;
+			vector<uint32_t> corridor;
+		};
+
+		const ProvinceGraph* graph = nullptr;
+
+		vector<Vector2> positions;
+		vector<float> factors;
+		vector<uint8_t> passable;
+		vector<uint32_t> province_cluster;
+
+		vector<Cluster> clusters;	// Indexed by CountryId
+
+		unordered_map<uint64_t, CachedPath> cache;
+		PathStats stats;
+
+		vector<SearchScratch> scratch;
+		vector<uint32_t> misses;
+		vector<uint8_t> miss_fallbacks;
+
+		static uint64_t cacheKey(ProvinceHandle from, ProvinceHandle to) { return ((uint64_t)from << 32) | to; }
+
+		static float distance(Vector2 a, Vector2 b)
+		{
+			float dx = a.x - b.x, dy = a.y - b.y;
+			return sqrtf(dx * dx + dy * dy);
+		}
+
+		// Countries founded after the build get their cluster here
+		uint32_t clusterOf(CountryId owner)
+		{
+			if(owner >= clusters.size()) clusters.resize((size_t)owner + 1);
+			return owner;
+		}
+
+		void addMember(uint32_t cluster, ProvinceHandle handle)
+		{
+			Cluster& c = clusters[cluster];
+			c.members++;
+			c.sum_x += positions[handle].x;
+			c.sum_y += positions[handle].y;
+			c.factor_sum += factors[handle];
+		}
+
+		void removeMember(uint32_t cluster, ProvinceHandle handle)
+		{
+			Cluster& c = clusters[cluster];
+			c.members--;
+			c.sum_x -= positions[handle].x;
+			c.sum_y -= positions[handle].y;
+			c.factor_sum -= factors[handle];
+		}
+
+		// Both directions, links whose count drops to zero are removed
+		void addLink(uint32_t a, uint32_t b, int delta)
+		{
+			for(int side = 0; side < 2; ++side)
+			{
+				auto& links = clusters[side ? b : a].links;
+				uint32_t other = side ? a : b;
+
+				auto it = find_if(links.begin(), links.end(), [&](const ClusterLink& link) { return link.cluster == other; });
+				if(it == links.end())
+				{
+					if(delta > 0) links.push_back({other, (uint32_t)delta});
+					continue;
+				}
+
+				it->count += delta;
+				if(it->count == 0) links.erase(it);
+			}
+		}
+
+		Vector2 centroid(uint32_t cluster) const
+		{
+			const Cluster& c = clusters[cluster];
+			if(c.members == 0) return {0, 0};
+			return { c.sum_x / c.members, c.sum_y / c.members };
+		}
+
+		float meanFactor(uint32_t cluster) const
+		{
+			const Cluster& c = clusters[cluster];
+			return c.members ? c.factor_sum / c.members : 1.0f;
+		}
+
+		bool lookup(ProvinceHandle from, ProvinceHandle to, Path& out)
+		{
+			auto it = cache.find(cacheKey(from, to));
+			if(it == cache.end()) return false;
+
+			for(const auto& entry : it->second.clusters)
+			{
+				if(clusters[entry.first].version != entry.second)
+				{
+					cache.erase(it);
+					return false;
+				}
+			}
+
+			out = it->second.path;
+			stats.cache_hits++;
+			return true;
+		}
+
+		// Unreachable goals aren't cached, whether they stay unreachable depends on the whole graph
+		void store(ProvinceHandle from, ProvinceHandle to, const Path& path)
+		{
+			if(!path.found()) return;
+			if(cache.size() >= MAX_CACHED_PATHS) cache.clear();
+
+			CachedPath& entry = cache[cacheKey(from, to)];
+			entry.path = path;
+			entry.clusters.clear();
+
+			for(ProvinceHandle handle : path.provinces)
+			{
+				uint32_t cluster = province_cluster[handle];
+				if(entry.clusters.empty() || entry.clusters.back().first != cluster)
+				{
+					entry.clusters.push_back({cluster, clusters[cluster].version});
+				}
+			}
+		}
+
+		void prepareScratch(size_t workers)
+		{
+			if(scratch.size() < workers) scratch.resize(workers);
+
+			for(size_t w = 0; w < workers; ++w)
+			{
+				SearchScratch& s = scratch[w];
+				if(s.g.size() == positions.size() && s.cluster_g.size() == clusters.size()) continue;
+
+				// Stamps start over with the sizes
+				s.g.assign(positions.size(), 0.0f);
+				s.parent.assign(positions.size(), INVALID_PROVINCE);
+				s.seen.assign(positions.size(), 0);
+				s.closed.assign(positions.size(), 0);
+				s.allowed.assign(clusters.size(), 0);
+				s.cluster_g.assign(clusters.size(), 0.0f);
+				s.cluster_parent.assign(clusters.size(), UINT32_MAX);
+				s.cluster_seen.assign(clusters.size(), 0);
+				s.cluster_closed.assign(clusters.size(), 0);
+				s.generation = 0;
+			}
+		}
+
+		// Only reads the shared state, safe to run on several workers with separate scratch
+		void solve(ProvinceHandle from, ProvinceHandle to, SearchScratch& s, Path& out, bool& fallback) const
+		{
+			out.provinces.clear();
+			out.cost = 0.0f;
+
+			if(from >= positions.size() || to >= positions.size() || !passable[to]) return;
+
+			if(from == to)
+			{
+				out.provinces.push_back(from);
+				return;
+			}
+
+			// Countries to cross, then provinces inside them. A corridor without a way through (an impassable
+			// province, an exclave) falls back to the whole graph.
+			if(findCorridor(province_cluster[from], province_cluster[to], s))
+			{
+				if(searchProvinces(from, to, true, s, out)) return;
+			}
+
+			fallback = true;
+			searchProvinces(from, to, false, s, out);
+		}
+
+		bool findCorridor(uint32_t from, uint32_t to, SearchScratch& s) const
+		{
+			uint32_t generation = ++s.generation;
+			s.corridor.clear();
+
+			Vector2 goal = centroid(to);
+
+			s.open.clear();
+			s.cluster_g[from] = 0.0f;
+			s.cluster_parent[from] = UINT32_MAX;
+			s.cluster_seen[from] = generation;
+			s.open.push_back({distance(centroid(from), goal), from});
+
+			bool reached = false;
+			while(!s.open.empty())
+			{
+				pop_heap(s.open.begin(), s.open.end(), greater<pair<float, uint32_t>>());
+				uint32_t cluster = s.open.back().second;
+				s.open.pop_back();
+
+				if(s.cluster_closed[cluster] == generation) continue;
+				s.cluster_closed[cluster] = generation;
+
+				if(cluster == to)
+				{
+					reached = true;
+					break;
+				}
+
+				for(const ClusterLink& link : clusters[cluster].links)
+				{
+					uint32_t next = link.cluster;
+					if(s.cluster_closed[next] == generation) continue;
+
+					float step = distance(centroid(cluster), centroid(next)) * 0.5f * (meanFactor(cluster) + meanFactor(next));
+					float g = s.cluster_g[cluster] + step;
+
+					if(s.cluster_seen[next] == generation && g >= s.cluster_g[next]) continue;
+
+					s.cluster_seen[next] = generation;
+					s.cluster_g[next] = g;
+					s.cluster_parent[next] = cluster;
+					s.open.push_back({g + distance(centroid(next), goal), next});
+					push_heap(s.open.begin(), s.open.end(), greater<pair<float, uint32_t>>());
+				}
+			}
+
+			if(!reached) return false;
+
+			// The clusters on the way plus their neighbours, so the province search can cut corners the
+			// centroid route doesn't see
+			for(uint32_t cluster = to; cluster != UINT32_MAX; cluster = s.cluster_parent[cluster])
+			{
+				s.corridor.push_back(cluster);
+				for(const ClusterLink& link : clusters[cluster].links) s.corridor.push_back(link.cluster);
+			}
+			return true;
+		}
+
+		// A* between interior points, restricted to the corridor clusters if asked to
+		bool searchProvinces(ProvinceHandle from, ProvinceHandle to, bool in_corridor, SearchScratch& s, Path& out) const
+		{
+			uint32_t generation = ++s.generation;
+			if(in_corridor)
+			{
+				for(uint32_t cluster : s.corridor) s.allowed[cluster] = generation;
+			}
+
+			// Terrain factors are at least 1, so the straight line never overestimates
+			Vector2 goal = positions[to];
+
+			s.open.clear();
+			s.g[from] = 0.0f;
+			s.parent[from] = INVALID_PROVINCE;
+			s.seen[from] = generation;
+			s.open.push_back({distance(positions[from], goal), from});
+
+			while(!s.open.empty())
+			{
+				pop_heap(s.open.begin(), s.open.end(), greater<pair<float, uint32_t>>());
+				ProvinceHandle current = s.open.back().second;
+				s.open.pop_back();
+
+				if(s.closed[current] == generation) continue;
+				s.closed[current] = generation;
+
+				if(current == to)
+				{
+					out.cost = s.g[to];
+					for(ProvinceHandle handle = to; handle != INVALID_PROVINCE; handle = s.parent[handle])
+					{
+						out.provinces.push_back(handle);
+					}
+					reverse(out.provinces.begin(), out.provinces.end());
+					return true;
+				}
+
+				for(ProvinceHandle next : graph->getNeighbours(current))
+				{
+					if(!passable[next] || s.closed[next] == generation) continue;
+					if(in_corridor && s.allowed[province_cluster[next]] != generation) continue;
+
+					float g = s.g[current] + getStepCost(current, next);
+
+					if(s.seen[next] == generation && g >= s.g[next]) continue;
+
+					s.seen[next] = generation;
+					s.g[next] = g;
+					s.parent[next] = current;
+					s.open.push_back({g + distance(positions[next], goal), next});
+					push_heap(s.open.begin(), s.open.end(), greater<pair<float, uint32_t>>());
+				}
+			}
+
+			return false;
+		}
+};
@@ -0,0 +1,212 @@
+#pragma once
+
+#include "province.hpp"
+#include "job_system.hpp"
+#include <algorithm>
+#include <cmath>
+#include <iostream>
+
+// CPU side image of province handles covering the map, for picking every frame with a single texel read.
+// Texels crossed by a ring outline are flagged ambiguous, only those still need the exact polygon test.
+class PickRaster
+{
+	public:
+		static constexpr uint32_t AMBIGUOUS = UINT32_MAX - 1;	// Texel value, INVALID_PROVINCE is open sea
+		static constexpr int DEFAULT_RESOLUTION = 2048;			// Texels along the longer side of the map
+
+		bool isReady() const { return !texels.empty(); }
+
+		// Rasterizes the triangulated provinces over a world space area, rows are split across the job system
+		void build(const vector<Province>& provinces, const Rectangle& map_area, int resolution, JobSystem& jobs)
+		{
+			area = map_area;
+			resolution = max(resolution, 1);
+
+			float longer = max(area.width, area.height);
+			if(longer <= 0.0f)
+			{
+				clear();
+				return;
+			}
+
+			scale = resolution / longer;
+			width = max(1, (int)ceilf(area.width * scale));
+			height = max(1, (int)ceilf(area.height * scale));
+
+			texels.assign((size_t)width * height, INVALID_PROVINCE);
+
+			// Rows every ring touches, so bands skip the rings that can't reach them
+			vector<RingRows> rings;
+			for(ProvinceHandle handle = 0; handle < provinces.size(); ++handle)
+			{
+				const auto& polygons = provinces[handle].polygons;
+				for(uint32_t poly_index = 0; poly_index < polygons.size(); ++poly_index)
+				{
+					if(polygons[poly_index].empty()) continue;
+
+					float y_min = 1e30f, y_max = -1e30f;
+					for(const auto& p : polygons[poly_index])
+					{
+						y_min = min(y_min, p.y);
+						y_max = max(y_max, p.y);
+					}
+					rings.push_back({handle, poly_index, (int)floorf(toTexel({0, y_min}).y), (int)floorf(toTexel({0, y_max}).y)});
+				}
+			}
+
+			// Bands of rows, every band walks the provinces last to first so the first one in load order wins
+			// overlaps, the same rule as the exact test
+			const int band_rows = 16;
+			size_t bands = (size_t)(height + band_rows - 1) / band_rows;
+
+			jobs.parallelFor(bands, 1, [&](size_t begin, size_t end, unsigned)
+			{
+				for(size_t band = begin; band < end; ++band)
+				{
+					int row_first = (int)band * band_rows;
+					int row_last = min(height, row_first + band_rows);
+
+					for(size_t r = rings.size(); r-- > 0;)
+					{
+						const RingRows& ring = rings[r];
+						if(ring.row_max < row_first || ring.row_min >= row_last) continue;
+
+						fillRing(provinces[ring.province], ring.polygon, ring.province, row_first, row_last);
+					}
+
+					for(const RingRows& ring : rings)
+					{
+						if(ring.row_max < row_first || ring.row_min >= row_last) continue;
+
+						const auto& points = provinces[ring.province].polygons[ring.polygon];
+						for(size_t i = 0, j = points.size() - 1; i < points.size(); j = i++)
+						{
+							markEdge(toTexel(points[j]), toTexel(points[i]), row_first, row_last);
+						}
+					}
+				}
+			});
+
+			size_t ambiguous = count(texels.begin(), texels.end(), AMBIGUOUS);
+			cout << "Built " << width << "x" << height << " pick raster (" << (ambiguous * 100 / texels.size()) << "% border texels)" << endl;
+		}
+
+		void clear()
+		{
+			texels.clear();
+			texels.shrink_to_fit();
+			width = height = 0;
+		}
+
+		// Province handle at a world point, INVALID_PROVINCE off the map or AMBIGUOUS near an outline
+		uint32_t lookup(Vector2 point) const
+		{
+			float x = (point.x - area.x) * scale;
+			float y = (point.y - area.y) * scale;
+			if(x < 0.0f || y < 0.0f || x >= width || y >= height) return INVALID_PROVINCE;
+
+			return texels[(size_t)y * width + (size_t)x];
+		}
+
+		int getWidth() const { return width; }
+		int getHeight() const { return height; }
+		const vector<uint32_t>& getTexels() const { return texels; }
+
+	private:
+		struct RingRows
+		{
+			ProvinceHandle province;
+			uint32_t polygon;
+			int row_min, row_max;
+		};
+
+		Rectangle area = {0, 0, 0, 0};
+		float scale = 1.0f;		// Texels per world unit
+		int width = 0, height = 0;
+
+		vector<uint32_t> texels;
+
+		Vector2 toTexel(Vector2 p) const { return { (p.x - area.x) * scale, (p.y - area.y) * scale }; }
+
+		// Every texel whose centre is inside one of the ring's triangles, within [row_first, row_last)
+		void fillRing(const Province& province, uint32_t poly_index, ProvinceHandle handle, int row_first, int row_last)
+		{
+			if(poly_index >= province.polygon_indices.size()) return;
+
+			const auto& poly = province.polygons[poly_index];
+			const auto& indices = province.polygon_indices[poly_index];
+
+			for(size_t i = 0; i + 2 < indices.size(); i += 3)
+			{
+				if(indices[i] >= poly.size() || indices[i+1] >= poly.size() || indices[i+2] >= poly.size()) continue;
+
+				fillTriangle(toTexel(poly[indices[i]]), toTexel(poly[indices[i+1]]), toTexel(poly[indices[i+2]]), handle, row_first, row_last);
+			}
+		}
+
+		void fillTriangle(Vector2 a, Vector2 b, Vector2 c, uint32_t value, int row_first, int row_last)
+		{
+			int y0 = max(row_first, (int)floorf(min(a.y, min(b.y, c.y))));
+			int y1 = min(row_last - 1, (int)ceilf(max(a.y, max(b.y, c.y))));
+			if(y0 > y1) return;
+
+			int x0 = max(0, (int)floorf(min(a.x, min(b.x, c.x))));
+			int x1 = min(width - 1, (int)ceilf(max(a.x, max(b.x, c.x))));
+			if(x0 > x1) return;
+
+			// Edge functions, sign independent of the winding
+			float area2 = (b.x - a.x) * (c.y - a.y) - (b.y - a.y) * (c.x - a.x);
+			if(area2 == 0.0f) return;
+			float sign = area2 > 0.0f ? 1.0f : -1.0f;
+
+			for(int y = y0; y <= y1; ++y)
+			{
+				float py = y + 0.5f;
+				uint32_t* row = &texels[(size_t)y * width];
+
+				for(int x = x0; x <= x1; ++x)
+				{
+					float px = x + 0.5f;
+
+					float w0 = ((b.x - a.x) * (py - a.y) - (b.y - a.y) * (px - a.x)) * sign;
+					float w1 = ((c.x - b.x) * (py - b.y) - (c.y - b.y) * (px - b.x)) * sign;
+					float w2 = ((a.x - c.x) * (py - c.y) - (a.y - c.y) * (px - c.x)) * sign;
+
+					if(w0 >= 0.0f && w1 >= 0.0f && w2 >= 0.0f) row[x] = value;
+				}
+			}
+		}
+
+		// Flags every texel the segment passes through, within [row_first, row_last)
+		void markEdge(Vector2 a, Vector2 b, int row_first, int row_last)
+		{
+			float y_min = min(a.y, b.y), y_max = max(a.y, b.y);
+
+			int r0 = max(row_first, (int)floorf(y_min));
+			int r1 = min(row_last - 1, (int)floorf(y_max));
+
+			for(int r = r0; r <= r1; ++r)
+			{
+				// Part of the segment inside this row
+				float lo = max(y_min, (float)r), hi = min(y_max, (float)(r + 1));
+
+				float xa, xb;
+				if(b.y == a.y)
+				{
+					xa = a.x;
+					xb = b.x;
+				}
+				else
+				{
+					xa = a.x + (b.x - a.x) * (lo - a.y) / (b.y - a.y);
+					xb = a.x + (b.x - a.x) * (hi - a.y) / (b.y - a.y);
+				}
+
+				int x0 = max(0, (int)floorf(min(xa, xb)));
+				int x1 = min(width - 1, (int)floorf(max(xa, xb)));
+
+				uint32_t* row = &texels[(size_t)r * width];
+				for(int x = x0; x <= x1; ++x) row[x] = AMBIGUOUS;
+			}
+		}
+};
@@ -0,0 +1,40 @@
+#pragma once
+
+#include "raylib.h"
+#include <vector>
+#include <string>
+#include <cstdint>
+
+using namespace std;
+
+// Index of a province inside MapEngine::getProvinces(), stable for the lifetime of a loaded map
+typedef uint32_t ProvinceHandle;
+
+static constexpr ProvinceHandle INVALID_PROVINCE = UINT32_MAX;
+
+struct Province
+{
+	string id;
+
+	string name;
+	string name_en;
+	string name_local;
+	Color color;
+	int admin_level;
+
+	vector<vector<Vector2>> polygons;
+	vector<vector<uint32_t>> polygon_indices;
+	vector<Rectangle> polygon_bounds;
+
+	// Label anchor inside the largest ring and total area, filled in after loading
+	Vector2 interior_point;
+	float area;
+
+	// NUTS data
+	string country_code;
+	float mountain_type;
+	float urban_type;
+	float coast_type;
+	string nuts_level;
+
+};
@@ -0,0 +1,360 @@
+#pragma once
+
+#include "province.hpp"
+#include "job_system.hpp"
+#include <algorithm>
+#include <cmath>
+#include <fstream>
+#include <iostream>
+
+#define PROVINCEGRAPH_ERR "LakyStrategy::ProvinceGraph::Error: "
+
+// Neighbours of one province, a view into ProvinceGraph
+struct NeighbourRange
+{
+	const ProvinceHandle* first;
+	const ProvinceHandle* last;
+
+	const ProvinceHandle* begin() const { return first; }
+	const ProvinceHandle* end() const { return last; }
+	size_t size() const { return last - first; }
+};
+
+// Which provinces share a border and how long that border is, as a CSR adjacency list indexed by province handle.
+// Edges are matched through their end points snapped to a grid, so rings from different sources (NUTS, OSM) that
+// are a little apart still connect. Built in parallel at load time and kept in a binary cache file next to the map.
+class ProvinceGraph
+{
+	public:
+		// World units. End points less than this apart on both axes are the same point, always. Bigger gaps are
+		// water or real borders.
+		static constexpr float SNAP_TOLERANCE = 1.0f / 64.0f;
+		static constexpr float SNAP_CELL = SNAP_TOLERANCE * 2.0f;
+
+		static constexpr uint32_t CACHE_MAGIC = 0x52474B4C;	// "LKGR"
+		static constexpr uint32_t CACHE_VERSION = 2;
+
+		void build(const vector<Province>& provinces, JobSystem& jobs)
+		{
+			// Global edge ids, so an edge found through several cells only counts its length once
+			vector<uint32_t> edge_first(provinces.size() + 1, 0);
+			for(size_t h = 0; h < provinces.size(); ++h)
+			{
+				uint32_t edges = 0;
+				for(const auto& ring : provinces[h].polygons) edges += (uint32_t)ring.size();
+				edge_first[h + 1] = edge_first[h] + edges;
+			}
+
+			vector<EdgeRecord> records(edge_first.back());
+
+			jobs.parallelFor(provinces.size(), 64, [&](size_t begin, size_t end, unsigned)
+			{
+				for(size_t h = begin; h < end; ++h)
+				{
+					uint32_t edge = edge_first[h];
+					for(const auto& ring : provinces[h].polygons)
+					{
+						for(size_t i = 0, j = ring.size() - 1; i < ring.size(); j = i++, ++edge)
+						{
+							EdgeRecord& record = records[edge];
+							record.province = (ProvinceHandle)h;
+							record.edge = edge;
+							record.from = ring[j];
+							record.to = ring[i];
+
+							float dx = ring[i].x - ring[j].x, dy = ring[i].y - ring[j].y;
+							record.length = sqrtf(dx * dx + dy * dy);
+
+							uint64_t a = cellKey(cellOf(ring[j].x), cellOf(ring[j].y)), b = cellKey(cellOf(ring[i].x), cellOf(ring[i].y));
+							record.lo = min(a, b);
+							record.hi = max(a, b);
+
+							// Collapsed at this tolerance, can't tell which way the border runs
+							if(samePoint(ring[j], ring[i])) record.province = INVALID_PROVINCE;
+						}
+					}
+				}
+			});
+
+			records.erase(remove_if(records.begin(), records.end(), [](const EdgeRecord& r) { return r.province == INVALID_PROVINCE; }), records.end());
+			sort(records.begin(), records.end());
+
+			// A point within the tolerance of another is in its cell or in the neighbouring one on the side of
+			// the nearer cell edge, on both axes. Each edge looks up the 2x2 cells around both of its end points
+			// and keeps the edges whose end points really are that close, so matching is exact and symmetric.
+			// Workers list (province, neighbour, edge, length) for their own records' side of every match.
+			vector<vector<SideMatch>> worker_matches(jobs.getThreadCount());
+
+			jobs.parallelFor(records.size(), 1024, [&](size_t begin, size_t end, unsigned worker)
+			{
+				vector<SideMatch>& matches = worker_matches[worker];
+
+				for(size_t a = begin; a < end; ++a)
+				{
+					const EdgeRecord& record = records[a];
+
+					uint64_t from_cells[4], to_cells[4];
+					nearCells(record.from, from_cells);
+					nearCells(record.to, to_cells);
+
+					for(uint64_t from_cell : from_cells)
+					{
+						for(uint64_t to_cell : to_cells)
+						{
+							EdgeRecord key = {};
+							key.lo = min(from_cell, to_cell);
+							key.hi = max(from_cell, to_cell);
+
+							auto first = lower_bound(records.begin(), records.end(), key, [](const EdgeRecord& r, const EdgeRecord& k) { return r.keyLess(k); });
+							for(auto other = first; other != records.end() && other->sameKey(key); ++other)
+							{
+								if(other->province == record.province || !record.sameEdge(*other)) continue;
+								matches.push_back({ record.province, other->province, record.edge, record.length });
+							}
+						}
+					}
+				}
+			});
+
+			vector<SideMatch> matches;
+			for(auto& list : worker_matches) matches.insert(matches.end(), list.begin(), list.end());
+
+			// One length per edge even if several cells or rings matched it
+			sort(matches.begin(), matches.end());
+			matches.erase(unique(matches.begin(), matches.end(), [](const SideMatch& a, const SideMatch& b)
+			{
+				return a.province == b.province && a.neighbour == b.neighbour && a.edge == b.edge;
+			}), matches.end());
+
+			// Sum per ordered pair, then average both sides so the lengths are symmetric
+			vector<SideMatch> pairs;
+			for(const auto& match : matches)
+			{
+				if(!pairs.empty() && pairs.back().province == match.province && pairs.back().neighbour == match.neighbour)
+				{
+					pairs.back().length += match.length;
+				}
+				else
+				{
+					pairs.push_back({ match.province, match.neighbour, 0, match.length });
+				}
+			}
+
+			offsets.assign(provinces.size() + 1, 0);
+			neighbours.resize(pairs.size());
+			border_lengths.resize(pairs.size());
+
+			for(size_t i = 0; i < pairs.size(); ++i)
+			{
+				offsets[pairs[i].province + 1]++;
+				neighbours[i] = pairs[i].neighbour;
+			}
+			for(size_t h = 1; h < offsets.size(); ++h) offsets[h] += offsets[h - 1];
+
+			for(size_t i = 0; i < pairs.size(); ++i)
+			{
+				size_t back = findEdge(pairs[i].neighbour, pairs[i].province);
+				border_lengths[i] = back < pairs.size() ? (pairs[i].length + pairs[back].length) * 0.5f : pairs[i].length;
+			}
+
+			cout << "Built province graph: " << neighbours.size() / 2 << " neighbour pairs" << endl;
+		}
+
+		NeighbourRange getNeighbours(ProvinceHandle handle) const
+		{
+			if((size_t)handle + 1 >= offsets.size()) return { nullptr, nullptr };
+			return { neighbours.data() + offsets[handle], neighbours.data() + offsets[handle + 1] };
+		}
+
+		// Shared border lengths, in the same order as getNeighbours
+		const float* getBorderLengths(ProvinceHandle handle) const
+		{
+			if((size_t)handle + 1 >= offsets.size()) return nullptr;
+			return border_lengths.data() + offsets[handle];
+		}
+
+		// 0 if the provinces aren't neighbours
+		float getBorderLength(ProvinceHandle a, ProvinceHandle b) const
+		{
+			size_t index = findEdge(a, b);
+			return index < border_lengths.size() ? border_lengths[index] : 0.0f;
+		}
+
+		bool areNeighbours(ProvinceHandle a, ProvinceHandle b) const { return findEdge(a, b) < neighbours.size(); }
+
+		size_t getProvinceCount() const { return offsets.empty() ? 0 : offsets.size() - 1; }
+		size_t getEdgeCount() const { return neighbours.size(); }
+
+		// Identifies the geometry the graph was built from, a cache made for other geometry is rejected
+		static uint64_t fingerprint(const vector<Province>& provinces)
+		{
+			uint64_t hash = 1469598103934665603ULL;	// FNV-1a
+			auto mix = [&](const void* data, size_t size)
+			{
+				const unsigned char* bytes = (const unsigned char*)data;
+				for(size_t i = 0; i < size; ++i)
+				{
+					hash ^= bytes[i];
+					hash *= 1099511628211ULL;
+				}
+			};
+
+			for(const auto& province : provinces)
+			{
+				mix(province.id.data(), province.id.size());
+				for(const auto& ring : province.polygons)
+				{
+					uint32_t size = (uint32_t)ring.size();
+					mix(&size, sizeof(size));
+					if(!ring.empty()) mix(ring.data(), ring.size() * sizeof(Vector2));
+				}
+			}
+
+			float tolerance = SNAP_TOLERANCE;
+			mix(&tolerance, sizeof(tolerance));
+			return hash;
+		}
+
+		bool save(const string& path, uint64_t source_fingerprint) const
+		{
+			ofstream file(path, ios::binary);
+			if(!file.is_open())
+			{
+				cerr << PROVINCEGRAPH_ERR << "Failed to write graph cache " << path << endl;
+				return false;
+			}
+
+			uint32_t header[2] = { CACHE_MAGIC, CACHE_VERSION };
+			uint64_t counts[2] = { (uint64_t)getProvinceCount(), (uint64_t)neighbours.size() };
+
+			file.write((const char*)header, sizeof(header));
+			file.write((const char*)&source_fingerprint, sizeof(source_fingerprint));
+			file.write((const char*)counts, sizeof(counts));
+			file.write((const char*)offsets.data(), offsets.size() * sizeof(uint32_t));
+			file.write((const char*)neighbours.data(), neighbours.size() * sizeof(ProvinceHandle));
+			file.write((const char*)border_lengths.data(), border_lengths.size() * sizeof(float));
+
+			return file.good();
+		}
+
+		// False if the file is missing, damaged or was made for other geometry
+		bool load(const string& path, uint64_t source_fingerprint, size_t province_count)
+		{
+			ifstream file(path, ios::binary);
+			if(!file.is_open()) return false;
+
+			uint32_t header[2] = {};
+			uint64_t stored_fingerprint = 0;
+			uint64_t counts[2] = {};
+
+			file.read((char*)header, sizeof(header));
+			file.read((char*)&stored_fingerprint, sizeof(stored_fingerprint));
+			file.read((char*)counts, sizeof(counts));
+
+			if(!file || header[0] != CACHE_MAGIC || header[1] != CACHE_VERSION || stored_fingerprint != source_fingerprint
+				|| counts[0] != province_count)
+			{
+				return false;
+			}
+
+			vector<uint32_t> new_offsets(counts[0] + 1);
+			vector<ProvinceHandle> new_neighbours(counts[1]);
+			vector<float> new_lengths(counts[1]);
+
+			file.read((char*)new_offsets.data(), new_offsets.size() * sizeof(uint32_t));
+			file.read((char*)new_neighbours.data(), new_neighbours.size() * sizeof(ProvinceHandle));
+			file.read((char*)new_lengths.data(), new_lengths.size() * sizeof(float));
+
+			if(!file || new_offsets.back() != counts[1])
+			{
+				cerr << PROVINCEGRAPH_ERR << "Graph cache " << path << " is damaged, rebuilding" << endl;
+				return false;
+			}
+
+			offsets = move(new_offsets);
+			neighbours = move(new_neighbours);
+			border_lengths = move(new_lengths);
+
+			cout << "Loaded province graph from " << path << ": " << neighbours.size() / 2 << " neighbour pairs" << endl;
+			return true;
+		}
+
+	private:
+		struct EdgeRecord
+		{
+			uint64_t lo, hi;		// Cells of the end points, smaller first
+			Vector2 from, to;
+			ProvinceHandle province;
+			uint32_t edge;
+			float length;
+
+			bool sameKey(const EdgeRecord& other) const { return lo == other.lo && hi == other.hi; }
+			bool keyLess(const EdgeRecord& other) const { return lo != other.lo ? lo < other.lo : hi < other.hi; }
+
+			// Either direction, neighbouring rings usually run the other way
+			bool sameEdge(const EdgeRecord& other) const
+			{
+				return (samePoint(from, other.from) && samePoint(to, other.to)) || (samePoint(from, other.to) && samePoint(to, other.from));
+			}
+
+			bool operator<(const EdgeRecord& other) const
+			{
+				if(lo != other.lo) return lo < other.lo;
+				if(hi != other.hi) return hi < other.hi;
+				return province < other.province;
+			}
+		};
+
+		struct SideMatch
+		{
+			ProvinceHandle province;
+			ProvinceHandle neighbour;
+			uint32_t edge;			// Province's own edge
+			float length;
+
+			bool operator<(const SideMatch& other) const
+			{
+				if(province != other.province) return province < other.province;
+				if(neighbour != other.neighbour) return neighbour < other.neighbour;
+				return edge < other.edge;
+			}
+		};
+
+		vector<uint32_t> offsets;			// Per province start in neighbours, plus the end
+		vector<ProvinceHandle> neighbours;	// Sorted per province
+		vector<float> border_lengths;		// Shared border length per neighbour entry
+
+		static bool samePoint(Vector2 a, Vector2 b)
+		{
+			return fabsf(a.x - b.x) < SNAP_TOLERANCE && fabsf(a.y - b.y) < SNAP_TOLERANCE;
+		}
+
+		static int32_t cellOf(float v) { return (int32_t)floorf(v / SNAP_CELL); }
+
+		static uint64_t cellKey(int32_t x, int32_t y) { return ((uint64_t)(uint32_t)x << 32) | (uint32_t)y; }
+
+		// The point's own cell and its neighbours towards the nearer cell edges, every point within the
+		// tolerance is in one of them (the cell is twice the tolerance)
+		static void nearCells(Vector2 p, uint64_t cells[4])
+		{
+			int32_t x = cellOf(p.x), y = cellOf(p.y);
+			int32_t nx = p.x - x * SNAP_CELL < SNAP_CELL * 0.5f ? x - 1 : x + 1;
+			int32_t ny = p.y - y * SNAP_CELL < SNAP_CELL * 0.5f ? y - 1 : y + 1;
+
+			cells[0] = cellKey(x, y);
+			cells[1] = cellKey(nx, y);
+			cells[2] = cellKey(x, ny);
+			cells[3] = cellKey(nx, ny);
+		}
+
+		size_t findEdge(ProvinceHandle a, ProvinceHandle b) const
+		{
+			if((size_t)a + 1 >= offsets.size()) return SIZE_MAX;
+
+			const ProvinceHandle* first = neighbours.data() + offsets[a];
+			const ProvinceHandle* last = neighbours.data() + offsets[a + 1];
+			const ProvinceHandle* it = lower_bound(first, last, b);
+
+			return (it != last && *it == b) ? (size_t)(it - neighbours.data()) : SIZE_MAX;
+		}
+};
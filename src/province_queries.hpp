@@ -0,0 +1,254 @@
+#pragma once
+
+#include "province.hpp"
+#include "geometry.hpp"
+#include "spatial_grid.hpp"
+#include "pick_raster.hpp"
+#include "ring_kernel.hpp"
+#include "province_graph.hpp"
+#include "job_system.hpp"
+#include <algorithm>
+
+// Which path answered the hover picks, accumulated until reset
+struct HoverStats
+{
+	uint32_t raster = 0;		// Unambiguous pick raster texel
+	uint32_t previous = 0;		// Still inside the previously hovered province
+	uint32_t neighbour = 0;		// Moved into one of its neighbours
+	uint32_t fallback = 0;		// Grid lookup
+};
+
+// Spatial queries over the provinces, backed by the load time grid (and the pick raster when enabled).
+// Results replace the contents of the caller's vector so its capacity is reused between calls.
+// Uses internal scratch buffers, call from one thread at a time.
+class ProvinceQueries
+{
+	public:
+		static constexpr size_t PARALLEL_MIN_POINTS = 1024;	// Smaller batches stay on the calling thread
+
+		void init(const vector<Province>* province_list, const SpatialGrid* province_grid, const PackedRings* packed_rings,
+			const PickRaster* pick_raster, const ProvinceGraph* province_graph, JobSystem* job_system)
+		{
+			provinces = province_list;
+			grid = province_grid;
+			rings = packed_rings;
+			raster = pick_raster;
+			graph = province_graph;
+			jobs = job_system;
+		}
+
+		// Province under a point, the first one in load order if rings overlap
+		ProvinceHandle queryPoint(Vector2 point) const
+		{
+			if(raster->isReady())
+			{
+				uint32_t texel = raster->lookup(point);
+				if(texel != PickRaster::AMBIGUOUS) return texel;
+			}
+
+			return testCandidates(grid->getCandidates(point), point);
+		}
+
+		// Pick for a cursor that moves a little every frame: the previous province, then its neighbours,
+		// then the grid. Any province containing the point may be returned (overlaps don't follow load order).
+		ProvinceHandle queryHover(Vector2 point, ProvinceHandle previous)
+		{
+			if(raster->isReady())
+			{
+				uint32_t texel = raster->lookup(point);
+				if(texel != PickRaster::AMBIGUOUS)
+				{
+					hover_stats.raster++;
+					return texel;
+				}
+			}
+
+			if(previous < provinces->size())
+			{
+				if(rings->containsProvince(previous, point))
+				{
+					hover_stats.previous++;
+					return previous;
+				}
+
+				for(ProvinceHandle neighbour : graph->getNeighbours(previous))
+				{
+					if(rings->containsProvince(neighbour, point))
+					{
+						hover_stats.neighbour++;
+						return neighbour;
+					}
+				}
+			}
+
+			hover_stats.fallback++;
+			return testCandidates(grid->getCandidates(point), point);
+		}
+
+		const HoverStats& getHoverStats() const { return hover_stats; }
+		void resetHoverStats() { hover_stats = HoverStats(); }
+
+		// Many points at once: sorted by grid cell so neighbouring lookups share cache lines, spread over the job system
+		void queryPoints(const Vector2* points, size_t count, ProvinceHandle* out)
+		{
+			batch_order.resize(count);
+			for(size_t i = 0; i < count; ++i)
+			{
+				batch_order[i] = ((uint64_t)grid->getCellIndex(points[i]) << 32) | (uint64_t)i;
+			}
+			sort(batch_order.begin(), batch_order.end());
+
+			auto run = [&](size_t begin, size_t end, unsigned)
+			{
+				for(size_t i = begin; i < end; ++i)
+				{
+					uint32_t index = (uint32_t)batch_order[i];
+					out[index] = queryPoint(points[index]);
+				}
+			};
+
+			if(jobs && count >= PARALLEL_MIN_POINTS) jobs->parallelFor(count, 256, run);
+			else run(0, count, 0);
+		}
+
+		// Provinces with a ring touching the rectangle (box selection)
+		size_t queryRect(const Rectangle& rect, vector<ProvinceHandle>& out)
+		{
+			out.clear();
+			grid->queryRect(rect, candidates);
+
+			for(const GridEntry* entry : candidates)
+			{
+				if(!out.empty() && out.back() == entry->province) continue;
+
+				if(ringIntersectsRect(ringOf(*entry), rect)) out.push_back(entry->province);
+			}
+			return out.size();
+		}
+
+		// Provinces whose interior point (label anchor) is inside a lasso polygon
+		size_t queryPolygon(const vector<Vector2>& lasso, vector<ProvinceHandle>& out)
+		{
+			out.clear();
+			if(lasso.size() < 3) return 0;
+
+			float minX = lasso[0].x, minY = lasso[0].y, maxX = minX, maxY = minY;
+			for(const auto& p : lasso)
+			{
+				minX = min(minX, p.x); minY = min(minY, p.y);
+				maxX = max(maxX, p.x); maxY = max(maxY, p.y);
+			}
+
+			grid->queryRect({minX, minY, maxX - minX, maxY - minY}, candidates);
+
+			ProvinceHandle last = INVALID_PROVINCE;
+			for(const GridEntry* entry : candidates)
+			{
+				if(entry->province == last) continue;
+				last = entry->province;
+
+				if(ringContains(lasso, (*provinces)[entry->province].interior_point)) out.push_back(entry->province);
+			}
+			return out.size();
+		}
+
+		// Provinces within a distance of a point (0 if the point is inside them)
+		size_t queryRadius(Vector2 centre, float radius, vector<ProvinceHandle>& out)
+		{
+			out.clear();
+
+			collectDistances(centre, radius);
+			for(const auto& item : distances) out.push_back(item.second);
+
+			return out.size();
+		}
+
+		// The k provinces closest to a point, nearest first. The search radius doubles until enough are found.
+		size_t queryNearest(Vector2 point, size_t k, vector<ProvinceHandle>& out)
+		{
+			out.clear();
+			if(k == 0 || grid->getEntryCount() == 0) return 0;
+
+			const Rectangle& area = grid->getArea();
+			float limit = sqrtf(area.width * area.width + area.height * area.height)
+				+ sqrtf(pointRectDistanceSq(point, area));
+
+			float radius = grid->getCellSize();
+			for(;;)
+			{
+				collectDistances(point, radius);
+				if(distances.size() >= k || radius > limit) break;
+				radius *= 2.0f;
+			}
+
+			size_t count = min(k, distances.size());
+			partial_sort(distances.begin(), distances.begin() + count, distances.end());
+
+			for(size_t i = 0; i < count; ++i) out.push_back(distances[i].second);
+			return out.size();
+		}
+
+	private:
+		const vector<Province>* provinces = nullptr;
+		const SpatialGrid* grid = nullptr;
+		const PackedRings* rings = nullptr;
+		const PickRaster* raster = nullptr;
+		const ProvinceGraph* graph = nullptr;
+		JobSystem* jobs = nullptr;
+
+		HoverStats hover_stats;
+
+		vector<const GridEntry*> candidates;
+		vector<pair<float, ProvinceHandle>> distances;	// Squared distance per province, from collectDistances
+		vector<uint64_t> batch_order;					// Cell << 32 | point index
+
+		const vector<Vector2>& ringOf(const GridEntry& entry) const
+		{
+			return (*provinces)[entry.province].polygons[entry.polygon];
+		}
+
+		ProvinceHandle testCandidates(pair<const GridEntry*, const GridEntry*> range, Vector2 point) const
+		{
+			for(const GridEntry* entry = range.first; entry != range.second; ++entry)
+			{
+				if(!SpatialGrid::boundsContain(entry->bounds, point)) continue;
+
+				if(rings->contains(entry->province, entry->polygon, point)) return entry->province;
+			}
+			return INVALID_PROVINCE;
+		}
+
+		// Every province within radius of the point with its closest ring distance
+		void collectDistances(Vector2 point, float radius)
+		{
+			distances.clear();
+			grid->queryRect({point.x - radius, point.y - radius, radius * 2, radius * 2}, candidates);
+
+			float radius_sq = radius * radius;
+
+			for(const GridEntry* entry : candidates)
+			{
+				if(pointRectDistanceSq(point, entry->bounds) > radius_sq) continue;
+
+				float distance = ringDistanceSq(ringOf(*entry), point);
+				if(distance > radius_sq) continue;
+
+				// Candidates come in province order, keep the closest ring of each
+				if(!distances.empty() && distances.back().second == entry->province)
+				{
+					distances.back().first = min(distances.back().first, distance);
+				}
+				else
+				{
+					distances.push_back({distance, entry->province});
+				}
+			}
+		}
+
+		static float pointRectDistanceSq(Vector2 p, const Rectangle& rect)
+		{
+			float dx = max(0.0f, max(rect.x - p.x, p.x - (rect.x + rect.width)));
+			float dy = max(0.0f, max(rect.y - p.y, p.y - (rect.y + rect.height)));
+			return dx * dx + dy * dy;
+		}
+};
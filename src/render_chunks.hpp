@@ -0,0 +1,355 @@
+#pragma once
+
+#include "province.hpp"
+#include "geometry.hpp"
+#include "job_system.hpp"
+#include "frame_profiler.hpp"
+#include "rlgl.h"
+#include <iostream>
+
+// The triangles of one ring (or a piece of a big ring) inside a chunk
+struct ChunkSpan
+{
+	ProvinceHandle province;
+	uint32_t first;		// Into RenderChunks vertices
+	uint32_t count;
+	Rectangle bounds;
+};
+
+// Spatially compact group of fill triangles that always fits in one rlgl batch
+struct RenderChunk
+{
+	Rectangle bounds;
+	uint32_t first_span;
+	uint32_t span_count;
+	uint32_t vertex_count;
+};
+
+// What the fill pass submitted, accumulated until reset
+struct ChunkStats
+{
+	uint32_t chunks_drawn = 0;
+	uint32_t vertices = 0;
+	uint32_t flushes = 0;		// Batches drawn because the next chunk wouldn't fit
+};
+
+// Visible geometry one worker thread culled and expanded, submitted later on the GL thread
+struct VertexStream
+{
+	struct ColorRun
+	{
+		Color color;
+		Vector2 texcoord;
+		uint32_t count;
+	};
+
+	struct Chunk
+	{
+		uint32_t run_count;
+		uint32_t vertex_count;
+	};
+
+	vector<Vector2> positions;
+	vector<ColorRun> runs;
+	vector<Chunk> chunks;
+
+	void clear()
+	{
+		positions.clear();
+		runs.clear();
+		chunks.clear();
+	}
+};
+
+// Province fills pre-expanded into triangle lists and grouped into spatial chunks at load time,
+// so culling and batch flushes happen per chunk instead of at arbitrary points mid-province
+class RenderChunks
+{
+	public:
+		// rlgl's default batch holds RL_DEFAULT_BATCH_BUFFER_ELEMENTS quads (4 vertices each).
+		// A chunk is a quarter of that, small enough to cull well and to never straddle a flush.
+		static constexpr uint32_t BATCH_VERTICES = RL_DEFAULT_BATCH_BUFFER_ELEMENTS * 4;
+		static constexpr uint32_t CHUNK_VERTICES = (BATCH_VERTICES / 4) / 3 * 3;
+
+		// Below this many chunks the work isn't worth waking the worker threads for
+		static constexpr size_t PARALLEL_MIN_CHUNKS = 16;
+
+		void build(const vector<Province>& provinces)
+		{
+			vertices.clear();
+			spans.clear();
+			chunks.clear();
+
+			// Expand every ring into triangles, cutting rings bigger than a chunk into pieces
+			vector<Vector2> expanded;
+			vector<ChunkSpan> pieces;
+			vector<Vector2> centres;
+			vector<uint32_t> weights;
+
+			for(ProvinceHandle handle = 0; handle < provinces.size(); ++handle)
+			{
+				const Province& province = provinces[handle];
+
+				for(size_t poly_index = 0; poly_index < province.polygons.size(); ++poly_index)
+				{
+					const auto& poly = province.polygons[poly_index];
+					const auto& indices = province.polygon_indices[poly_index];
+
+					uint32_t ring_first = (uint32_t)expanded.size();
+
+					for(size_t i = 0; i + 2 < indices.size(); i += 3)
+					{
+						uint32_t idxA = indices[i], idxB = indices[i+1], idxC = indices[i+2];
+						if(idxA >= poly.size() || idxB >= poly.size() || idxC >= poly.size()) continue;
+
+						expanded.push_back(poly[idxA]);
+						expanded.push_back(poly[idxC]);
+						expanded.push_back(poly[idxB]);
+					}
+
+					uint32_t ring_last = (uint32_t)expanded.size();
+
+					for(uint32_t first = ring_first; first < ring_last; first += CHUNK_VERTICES)
+					{
+						uint32_t count = min(CHUNK_VERTICES, ring_last - first);
+						Rectangle bounds = boundsOf(expanded, first, count);
+
+						pieces.push_back({handle, first, count, bounds});
+						centres.push_back({bounds.x + bounds.width / 2, bounds.y + bounds.height / 2});
+						weights.push_back(count);
+					}
+				}
+			}
+
+			vector<uint32_t> order(pieces.size());
+			for(uint32_t i = 0; i < order.size(); ++i) order[i] = i;
+
+			vector<pair<size_t, size_t>> groups;
+			if(!order.empty()) partitionByMedian(order, 0, order.size(), centres, weights, CHUNK_VERTICES, groups);
+
+			// Lay the vertices out chunk by chunk
+			vertices.reserve(expanded.size());
+			spans.reserve(pieces.size());
+			chunks.reserve(groups.size());
+
+			for(const auto& group : groups)
+			{
+				RenderChunk chunk;
+				chunk.first_span = (uint32_t)spans.size();
+				chunk.span_count = (uint32_t)(group.second - group.first);
+				chunk.vertex_count = 0;
+
+				float minX = 1e30f, minY = 1e30f, maxX = -1e30f, maxY = -1e30f;
+
+				for(size_t i = group.first; i < group.second; ++i)
+				{
+					ChunkSpan span = pieces[order[i]];
+
+					uint32_t first = (uint32_t)vertices.size();
+					vertices.insert(vertices.end(), expanded.begin() + span.first, expanded.begin() + span.first + span.count);
+					span.first = first;
+
+					chunk.vertex_count += span.count;
+
+					minX = min(minX, span.bounds.x);
+					minY = min(minY, span.bounds.y);
+					maxX = max(maxX, span.bounds.x + span.bounds.width);
+					maxY = max(maxY, span.bounds.y + span.bounds.height);
+
+					spans.push_back(span);
+				}
+
+				chunk.bounds = {minX, minY, maxX - minX, maxY - minY};
+				chunks.push_back(chunk);
+			}
+
+			cout << "Built " << chunks.size() << " render chunks (" << vertices.size() << " vertices, up to " << CHUNK_VERTICES << " per chunk)" << endl;
+		}
+
+		// Draws the chunks that intersect a world space area, colours come from the provinces.
+		// With a job system the culling and vertex building run on all cores and only the submission stays here.
+		void render(const Rectangle& area, const vector<Province>& provinces, JobSystem* jobs = nullptr, FrameProfiler* profiler = nullptr)
+		{
+			ChunkStats before = stats;
+
+			if(jobs && jobs->getThreadCount() > 1 && chunks.size() >= PARALLEL_MIN_CHUNKS)
+			{
+				{
+					ProfileScope scope(profiler, FRAME_STAGE_CULL);
+					prepare(area, provinces, *jobs);
+				}
+				{
+					ProfileScope scope(profiler, FRAME_STAGE_FILL);
+					submit();
+				}
+			}
+			else
+			{
+				ProfileScope scope(profiler, FRAME_STAGE_FILL);
+				renderSerial(area, provinces);
+			}
+
+			if(profiler)
+			{
+				uint32_t drawn = stats.vertices - before.vertices;
+				profiler->addDraw(drawn / 3, drawn, stats.flushes - before.flushes);
+			}
+		}
+
+		// Culls and submits on the calling thread in one pass
+		void renderSerial(const Rectangle& area, const vector<Province>& provinces)
+		{
+			rlBegin(RL_TRIANGLES);
+
+			for(const auto& chunk : chunks)
+			{
+				if(!CheckCollisionRecs(chunk.bounds, area)) continue;
+
+				// Flush now if the chunk wouldn't fit, instead of somewhere in the middle of it
+				if(rlCheckRenderBatchLimit((int)chunk.vertex_count)) stats.flushes++;
+
+				stats.chunks_drawn++;
+
+				bool contained = containsRect(area, chunk.bounds);
+
+				for(uint32_t s = chunk.first_span; s < chunk.first_span + chunk.span_count; ++s)
+				{
+					const ChunkSpan& span = spans[s];
+					if(!contained && !CheckCollisionRecs(span.bounds, area)) continue;
+
+					const Color& color = provinces[span.province].color;
+					rlColor4ub(color.r, color.g, color.b, color.a);
+
+					const Vector2 texcoord = getTexcoord(span.province);
+					rlTexCoord2f(texcoord.x, texcoord.y);
+
+					for(uint32_t v = span.first; v < span.first + span.count; ++v)
+					{
+						rlVertex2f(vertices[v].x, vertices[v].y);
+					}
+
+					stats.vertices += span.count;
+				}
+			}
+
+			rlEnd();
+		}
+
+		// Parallel stage: workers cull chunks and write the visible triangles into their own stream
+		void prepare(const Rectangle& area, const vector<Province>& provinces, JobSystem& jobs)
+		{
+			streams.resize(jobs.getThreadCount());
+			for(auto& stream : streams) stream.clear();
+
+			jobs.parallelFor(chunks.size(), 4, [&](size_t begin, size_t end, unsigned worker)
+			{
+				VertexStream& stream = streams[worker];
+
+				for(size_t c = begin; c < end; ++c)
+				{
+					const RenderChunk& chunk = chunks[c];
+					if(!CheckCollisionRecs(chunk.bounds, area)) continue;
+
+					bool contained = containsRect(area, chunk.bounds);
+
+					VertexStream::Chunk record = {0, 0};
+
+					for(uint32_t s = chunk.first_span; s < chunk.first_span + chunk.span_count; ++s)
+					{
+						const ChunkSpan& span = spans[s];
+						if(!contained && !CheckCollisionRecs(span.bounds, area)) continue;
+
+						stream.positions.insert(stream.positions.end(), vertices.begin() + span.first, vertices.begin() + span.first + span.count);
+						stream.runs.push_back({provinces[span.province].color, getTexcoord(span.province), span.count});
+
+						record.run_count++;
+						record.vertex_count += span.count;
+					}
+
+					if(record.vertex_count > 0) stream.chunks.push_back(record);
+				}
+			});
+		}
+
+		// GL thread stage: hands the prepared streams to rlgl, flushing only between chunks
+		void submit()
+		{
+			rlBegin(RL_TRIANGLES);
+
+			for(const auto& stream : streams)
+			{
+				size_t vertex = 0;
+				size_t run = 0;
+
+				for(const auto& record : stream.chunks)
+				{
+					if(rlCheckRenderBatchLimit((int)record.vertex_count)) stats.flushes++;
+
+					stats.chunks_drawn++;
+					stats.vertices += record.vertex_count;
+
+					for(uint32_t r = 0; r < record.run_count; ++r, ++run)
+					{
+						const VertexStream::ColorRun& color_run = stream.runs[run];
+						rlColor4ub(color_run.color.r, color_run.color.g, color_run.color.b, color_run.color.a);
+						rlTexCoord2f(color_run.texcoord.x, color_run.texcoord.y);
+
+						for(uint32_t v = 0; v < color_run.count; ++v, ++vertex)
+						{
+							rlVertex2f(stream.positions[vertex].x, stream.positions[vertex].y);
+						}
+					}
+				}
+			}
+
+			rlEnd();
+		}
+
+		// Per province texture coordinate emitted with its vertices (where the map mode shader finds its data)
+		void setProvinceTexcoords(const vector<Vector2>& province_texcoords) { texcoords = province_texcoords; }
+
+		const vector<RenderChunk>& getChunks() const { return chunks; }
+		const vector<ChunkSpan>& getSpans() const { return spans; }
+		const vector<Vector2>& getVertices() const { return vertices; }
+
+		const ChunkStats& getStats() const { return stats; }
+		void resetStats() { stats = ChunkStats(); }
+
+	private:
+		vector<Vector2> vertices;
+		vector<ChunkSpan> spans;
+		vector<RenderChunk> chunks;
+
+		ChunkStats stats;
+
+		vector<VertexStream> streams;	// One per job system thread
+
+		vector<Vector2> texcoords;
+
+		Vector2 getTexcoord(ProvinceHandle handle) const
+		{
+			return handle < texcoords.size() ? texcoords[handle] : Vector2{0, 0};
+		}
+
+		static bool containsRect(const Rectangle& outer, const Rectangle& inner)
+		{
+			return inner.x >= outer.x && inner.y >= outer.y
+				&& inner.x + inner.width <= outer.x + outer.width
+				&& inner.y + inner.height <= outer.y + outer.height;
+		}
+
+		static Rectangle boundsOf(const vector<Vector2>& points, uint32_t first, uint32_t count)
+		{
+			if(count == 0) return {0, 0, 0, 0};
+
+			float minX = points[first].x, minY = points[first].y, maxX = minX, maxY = minY;
+			for(uint32_t i = first; i < first + count; ++i)
+			{
+				minX = min(minX, points[i].x);
+				minY = min(minY, points[i].y);
+				maxX = max(maxX, points[i].x);
+				maxY = max(maxY, points[i].y);
+			}
+			return {minX, minY, maxX - minX, maxY - minY};
+		}
+};
@@ -0,0 +1,179 @@
+#pragma once
+
+#include "province.hpp"
+#include <cstdint>
+#include <algorithm>
+
+#if defined(__AVX2__)
+	#include <immintrin.h>
+	#define RING_KERNEL_WIDTH 8
+	#define RING_KERNEL_NAME "AVX2"
+#elif defined(__SSE2__) || defined(_M_X64)
+	#include <emmintrin.h>
+	#define RING_KERNEL_WIDTH 4
+	#define RING_KERNEL_NAME "SSE2"
+#else
+	#define RING_KERNEL_WIDTH 1
+	#define RING_KERNEL_NAME "scalar"
+#endif
+
+// Point in ring tests over packed (SoA) ring vertices, 4 or 8 edges per iteration.
+// A ring of n vertices is stored as n + 1 floats per axis: its last vertex followed by all of them in order,
+// so edge k runs from vertex k to vertex k + 1 and matches the (j, i) pairs of the crossing loop in ringContains.
+// Same operations in the same order as that loop, so the answers are identical, not just close.
+
+// Lanes set in a movemask result
+inline uint32_t maskBitCount(int mask)
+{
+	uint32_t count = 0;
+	for(; mask; mask &= mask - 1) count++;
+	return count;
+}
+
+// One edge at a time, also handles the tails of the vector kernels
+inline uint32_t ringCrossingsScalar(const float* xs, const float* ys, size_t first, size_t edges, float px, float py)
+{
+	uint32_t crossings = 0;
+	for(size_t k = first; k < edges; ++k)
+	{
+		float xj = xs[k], yj = ys[k];
+		float xi = xs[k + 1], yi = ys[k + 1];
+
+		if(((yi > py) != (yj > py)) && (px < (xj - xi) * (py - yi) / (yj - yi) + xi)) crossings++;
+	}
+	return crossings;
+}
+
+inline bool ringContainsPacked(const float* xs, const float* ys, size_t edges, Vector2 point)
+{
+	const float px = point.x, py = point.y;
+	uint32_t crossings = 0;
+	size_t k = 0;
+
+#if RING_KERNEL_WIDTH == 8
+	const __m256 vpx = _mm256_set1_ps(px);
+	const __m256 vpy = _mm256_set1_ps(py);
+
+	for(; k + 8 <= edges; k += 8)
+	{
+		__m256 xj = _mm256_loadu_ps(xs + k), yj = _mm256_loadu_ps(ys + k);
+		__m256 xi = _mm256_loadu_ps(xs + k + 1), yi = _mm256_loadu_ps(ys + k + 1);
+
+		// (yi > py) != (yj > py)
+		__m256 straddles = _mm256_xor_ps(_mm256_cmp_ps(yi, vpy, _CMP_GT_OQ), _mm256_cmp_ps(yj, vpy, _CMP_GT_OQ));
+
+		// Lanes that don't straddle may divide by zero, they are masked out anyway
+		__m256 x = _mm256_add_ps(_mm256_div_ps(_mm256_mul_ps(_mm256_sub_ps(xj, xi), _mm256_sub_ps(vpy, yi)), _mm256_sub_ps(yj, yi)), xi);
+		__m256 hits = _mm256_and_ps(straddles, _mm256_cmp_ps(vpx, x, _CMP_LT_OQ));
+
+		crossings += maskBitCount(_mm256_movemask_ps(hits));
+	}
+#elif RING_KERNEL_WIDTH == 4
+	const __m128 vpx = _mm_set1_ps(px);
+	const __m128 vpy = _mm_set1_ps(py);
+
+	for(; k + 4 <= edges; k += 4)
+	{
+		__m128 xj = _mm_loadu_ps(xs + k), yj = _mm_loadu_ps(ys + k);
+		__m128 xi = _mm_loadu_ps(xs + k + 1), yi = _mm_loadu_ps(ys + k + 1);
+
+		__m128 straddles = _mm_xor_ps(_mm_cmpgt_ps(yi, vpy), _mm_cmpgt_ps(yj, vpy));
+
+		__m128 x = _mm_add_ps(_mm_div_ps(_mm_mul_ps(_mm_sub_ps(xj, xi), _mm_sub_ps(vpy, yi)), _mm_sub_ps(yj, yi)), xi);
+		__m128 hits = _mm_and_ps(straddles, _mm_cmplt_ps(vpx, x));
+
+		crossings += maskBitCount(_mm_movemask_ps(hits));
+	}
+#endif
+
+	crossings += ringCrossingsScalar(xs, ys, k, edges, px, py);
+	return (crossings & 1) != 0;
+}
+
+// Every province ring packed for the kernel, built once at load
+class PackedRings
+{
+	public:
+		void build(const vector<Province>& provinces)
+		{
+			xs.clear();
+			ys.clear();
+			ring_bounds.clear();
+			ring_first.clear();
+			province_first.clear();
+
+			for(const auto& province : provinces)
+			{
+				province_first.push_back((uint32_t)ring_first.size());
+
+				for(const auto& ring : province.polygons)
+				{
+					ring_first.push_back((uint32_t)xs.size());
+					add(ring);
+				}
+			}
+
+			province_first.push_back((uint32_t)ring_first.size());
+			ring_first.push_back((uint32_t)xs.size());
+		}
+
+		// Same answer as ringContains(provinces[handle].polygons[polygon], point)
+		bool contains(ProvinceHandle handle, uint32_t polygon, Vector2 point) const
+		{
+			uint32_t ring = province_first[handle] + polygon;
+			uint32_t first = ring_first[ring];
+			uint32_t count = ring_first[ring + 1] - first;
+			if(count < 2) return false;
+
+			return ringContainsPacked(xs.data() + first, ys.data() + first, count - 1, point);
+		}
+
+		// Any of the province's rings, bounds first
+		bool containsProvince(ProvinceHandle handle, Vector2 point) const
+		{
+			for(uint32_t ring = province_first[handle]; ring < province_first[handle + 1]; ++ring)
+			{
+				const Rectangle& bounds = ring_bounds[ring];
+				if(point.x < bounds.x || point.y < bounds.y || point.x > bounds.x + bounds.width || point.y > bounds.y + bounds.height) continue;
+
+				uint32_t first = ring_first[ring];
+				uint32_t count = ring_first[ring + 1] - first;
+				if(count >= 2 && ringContainsPacked(xs.data() + first, ys.data() + first, count - 1, point)) return true;
+			}
+			return false;
+		}
+
+		size_t getVertexCount() const { return xs.size(); }
+
+	private:
+		vector<float> xs, ys;
+		vector<Rectangle> ring_bounds;
+		vector<uint32_t> ring_first;		// Per ring offset into xs / ys, plus the end
+		vector<uint32_t> province_first;	// Per province index into ring_first, plus the end
+
+		void add(const vector<Vector2>& ring)
+		{
+			if(ring.empty())
+			{
+				ring_bounds.push_back({0, 0, -1, -1});
+				return;
+			}
+
+			float minX = ring[0].x, minY = ring[0].y, maxX = minX, maxY = minY;
+			for(const auto& p : ring)
+			{
+				minX = min(minX, p.x); minY = min(minY, p.y);
+				maxX = max(maxX, p.x); maxY = max(maxY, p.y);
+			}
+			ring_bounds.push_back({minX, minY, maxX - minX, maxY - minY});
+
+			xs.push_back(ring.back().x);
+			ys.push_back(ring.back().y);
+
+			for(const auto& p : ring)
+			{
+				xs.push_back(p.x);
+				ys.push_back(p.y);
+			}
+		}
+};
@@ -0,0 +1,422 @@
+#pragma once
+
+#include "province.hpp"
+#include "ownership.hpp"
+#include "province_graph.hpp"
+#include "pathfinding.hpp"
+#include "divisions.hpp"
+#include "supply.hpp"
+#include "economy.hpp"
+#include "job_system.hpp"
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <atomic>
+#include <chrono>
+#include <functional>
+#include <vector>
+
+enum SimSpeed
+{
+	SIM_PAUSED = 0,
+	SIM_SPEED_1,
+	SIM_SPEED_2,
+	SIM_SPEED_3,
+	SIM_SPEED_4,
+	SIM_SPEED_5,
+	SIM_UNCAPPED,		// As many ticks as the thread can do
+
+	SIM_SPEED_COUNT
+};
+
+static const char* SIM_SPEED_NAMES[SIM_SPEED_COUNT] = { "Paused", "1x", "2x", "3x", "4x", "5x", "Uncapped" };
+
+// Game state as of one tick, read by the renderer while the sim thread fills the next one
+struct SimSnapshot
+{
+	uint64_t tick = 0;
+	uint64_t owner_version = 0;		// Changes whenever an owner does, the renderer only diffs the owners then
+	vector<CountryId> owners;		// Per province handle
+	DivisionSnapshot divisions;
+	uint64_t supply_version = 0;
+	vector<float> supply;			// Per province handle, 0..1
+	vector<CountryEconomy> economy;	// Per CountryId
+	float ticks_per_second = 0.0f;
+};
+
+enum SimCommandType
+{
+	SIM_COMMAND_TRANSFER,	// provinces go to country
+	SIM_COMMAND_ANNEX,		// Every province of target goes to country
+	SIM_COMMAND_SPAWN,		// A division of country (of division_type) in each of provinces
+	SIM_COMMAND_MOVE,		// Divisions of country stationed in provinces march to destination
+	SIM_COMMAND_DEPOT,		// Toggles a supply depot in each of provinces that country owns
+	SIM_COMMAND_DISBAND		// Divisions of country stationed in provinces are disbanded
+};
+
+struct SimCommand
+{
+	SimCommandType type;
+	CountryId country;
+	CountryId target = INVALID_COUNTRY;
+	ProvinceHandle destination = INVALID_PROVINCE;
+	vector<ProvinceHandle> provinces;
+	DivisionType division_type = DIVISION_INFANTRY;
+};
+
+// Game logic on its own thread at a fixed tick rate, independent of the frame rate.
+// Input reaches it through a command queue, applied at the start of the next tick (also while paused).
+// After every tick it publishes a snapshot through a lock-free triple buffer: the renderer always gets the
+// newest complete one without waiting, and the sim never waits for the renderer.
+class Simulation
+{
+	public:
+		static constexpr int BASE_TICK_RATE = 8;	// Ticks per second at 1x
+		static constexpr int MAX_CATCH_UP = 8;		// Ticks the sim may run late before it drops the backlog
+		static constexpr int SUPPLY_INTERVAL = 24;	// Ticks between supply updates, a day
+
+		~Simulation() { stop(); }
+
+		// Copies the starting state and starts the thread, paused. The graph is only referenced, it doesn't
+		// change after loading.
+		void start(const vector<Province>& provinces, const ProvinceGraph& graph, const Ownership& ownership)
+		{
+			stop();
+
+			owners = ownership.getOwners();
+			owner_version = 1;
+			tick = 0;
+
+			pathfinder.build(provinces, graph, owners);
+			divisions.init(provinces.size());
+			supply.build(provinces, graph, owners);
+			supply.update(jobs);
+			supply_version = 1;
+			economy.build(provinces, owners);
+
+			for(auto& slot : slots)
+			{
+				slot.tick = 0;
+				slot.owners = owners;
+				slot.owner_version = owner_version;
+				divisions.copyTo(slot.divisions);
+				slot.supply = supply.getSupply();
+				slot.supply_version = supply_version;
+				slot.economy = economy.getCountryTotals();
+			}
+			front = 0;
+			middle.store(1);
+			back = 2;
+
+			stopping = false;
+			worker = thread([this] { run(); });
+		}
+
+		void stop()
+		{
+			if(!worker.joinable()) return;
+
+			{
+				lock_guard<mutex> lock(command_mutex);
+				stopping = true;
+			}
+			wake.notify_all();
+			worker.join();
+		}
+
+		SimSpeed getSpeed() const { return (SimSpeed)speed.load(); }
+		bool isRunning() const { return getSpeed() != SIM_PAUSED; }
+
+		void setSpeed(SimSpeed new_speed)
+		{
+			{
+				lock_guard<mutex> lock(command_mutex);
+				speed.store(new_speed);
+			}
+			wake.notify_all();
+		}
+
+		// Applied by the sim thread before its next tick
+		void post(SimCommand command)
+		{
+			{
+				lock_guard<mutex> lock(command_mutex);
+				commands.push_back(move(command));
+				posted_commands++;
+			}
+			wake.notify_all();
+		}
+
+		// Renderer side: the newest published snapshot, stays valid until the next call
+		const SimSnapshot& acquireSnapshot()
+		{
+			if(middle.load() & FRESH) front = middle.exchange(front) & INDEX;
+			return slots[front];
+		}
+
+		// The renderer has to draw another frame: a snapshot is waiting, or posted commands haven't shown up in
+		// one yet. Snapshots published later come with the publish callback.
+		bool needsFrames() const
+		{
+			return (middle.load() & FRESH) || applied_commands.load() != posted_commands.load();
+		}
+
+		// Called on the sim thread when a snapshot is published after the renderer took the previous one, to wake
+		// a renderer sleeping on events. Set it before start.
+		void setPublishCallback(function<void()> callback) { on_publish = move(callback); }
+
+	private:
+		static constexpr uint32_t INDEX = 3;
+		static constexpr uint32_t FRESH = 4;	// Middle slot was published and not picked up yet
+
+		thread worker;
+		bool stopping = false;
+
+		atomic<int> speed{SIM_PAUSED};
+
+		mutex command_mutex;
+		condition_variable wake;
+		vector<SimCommand> commands;
+		vector<SimCommand> applying;
+		atomic<uint64_t> posted_commands{0};
+		atomic<uint64_t> applied_commands{0};
+		function<void()> on_publish;
+
+		// Triple buffer: the sim writes back, the renderer reads front, middle holds the newest one between them
+		SimSnapshot slots[3];
+		atomic<uint32_t> middle{1};
+		uint32_t front = 0;		// Renderer thread only
+		uint32_t back = 2;		// Sim thread only
+
+		// Sim thread state
+		uint64_t tick = 0;
+		uint64_t owner_version = 0;
+		vector<CountryId> owners;
+		float ticks_per_second = 0.0f;
+
+		// Its own workers, on the simulation's share of the cores
+		JobSystem jobs{simulationThreadCount() - 1};
+		Pathfinder pathfinder;
+		Divisions divisions;
+		SupplyNetwork supply;
+		uint64_t supply_version = 0;
+		Economy economy;
+
+		vector<DivisionId> move_divisions;		// Also collects for orderDisband
+		vector<PathRequest> move_requests;
+		vector<Path> move_paths;
+
+		void run()
+		{
+			using clock = chrono::steady_clock;
+
+			clock::time_point next = clock::now();
+			clock::time_point rate_start = next;
+			uint64_t rate_ticks = 0;
+
+			for(;;)
+			{
+				uint64_t taken = 0;
+				{
+					lock_guard<mutex> lock(command_mutex);
+					if(stopping) return;
+
+					applying.swap(commands);
+					taken = posted_commands.load();
+				}
+				bool changed = applyCommands();
+
+				SimSpeed current = getSpeed();
+				clock::time_point now = clock::now();
+
+				if(current != SIM_PAUSED && (current == SIM_UNCAPPED || now >= next))
+				{
+					step();
+					rate_ticks++;
+
+					if(current == SIM_UNCAPPED)
+					{
+						next = now;
+					}
+					else
+					{
+						clock::duration period = chrono::nanoseconds(1000000000LL / (BASE_TICK_RATE * current));
+						next += period;
+						if(now - next > period * MAX_CATCH_UP) next = now;
+					}
+
+					if(now - rate_start >= chrono::milliseconds(500))
+					{
+						ticks_per_second = (float)(rate_ticks / chrono::duration<double>(now - rate_start).count());
+						rate_start = now;
+						rate_ticks = 0;
+					}
+
+					publish(taken);
+					continue;
+				}
+
+				if(changed || taken != applied_commands.load()) publish(taken);
+
+				// Sleep until the next tick (or for good while paused), commands and speed changes wake it early
+				unique_lock<mutex> lock(command_mutex);
+				auto woken = [&] { return stopping || !commands.empty() || speed.load() != current; };
+
+				if(current == SIM_PAUSED)
+				{
+					wake.wait(lock, woken);
+
+					next = clock::now();
+					rate_start = next;
+					rate_ticks = 0;
+					ticks_per_second = 0.0f;
+				}
+				else
+				{
+					wake.wait_until(lock, next, woken);
+				}
+			}
+		}
+
+		// One fixed step of game time (an hour). Game systems run here, on the sim thread's own state.
+		void step()
+		{
+			// Only countries whose provinces or depots changed are propagated again
+			if(tick % SUPPLY_INTERVAL == 0 && supply.update(jobs) > 0) supply_version++;
+
+			divisions.update(1.0f, pathfinder, supply.getSupply().data(), jobs);
+			economy.update(1.0f, jobs);
+			tick++;
+		}
+
+		// Returns true if an owner changed
+		bool applyCommands()
+		{
+			bool changed = false;
+			for(const SimCommand& command : applying)
+			{
+				if(command.country == INVALID_COUNTRY) continue;
+
+				if(command.type == SIM_COMMAND_TRANSFER)
+				{
+					for(ProvinceHandle handle : command.provinces)
+					{
+						if(handle >= owners.size() || owners[handle] == command.country) continue;
+
+						owners[handle] = command.country;
+						pathfinder.setOwner(handle, command.country);
+						supply.setOwner(handle, command.country);
+						economy.setOwner(handle, command.country);
+						changed = true;
+					}
+				}
+				else if(command.type == SIM_COMMAND_ANNEX)
+				{
+					if(command.target == command.country) continue;
+
+					for(ProvinceHandle handle = 0; handle < owners.size(); ++handle)
+					{
+						if(owners[handle] != command.target) continue;
+
+						owners[handle] = command.country;
+						pathfinder.setOwner(handle, command.country);
+						supply.setOwner(handle, command.country);
+						economy.setOwner(handle, command.country);
+						changed = true;
+					}
+				}
+				else if(command.type == SIM_COMMAND_SPAWN)
+				{
+					for(ProvinceHandle handle : command.provinces) divisions.spawn(handle, command.country, command.division_type);
+				}
+				else if(command.type == SIM_COMMAND_MOVE)
+				{
+					orderMove(command);
+				}
+				else if(command.type == SIM_COMMAND_DEPOT)
+				{
+					for(ProvinceHandle handle : command.provinces)
+					{
+						if(handle < owners.size() && owners[handle] == command.country) supply.setDepot(handle, !supply.isDepot(handle));
+					}
+				}
+				else if(command.type == SIM_COMMAND_DISBAND)
+				{
+					orderDisband(command);
+				}
+			}
+			applying.clear();
+
+			if(changed) owner_version++;
+			return changed;
+		}
+
+		// Paths for every division of the command are solved as one batch
+		void orderMove(const SimCommand& command)
+		{
+			if(command.destination >= owners.size()) return;
+
+			move_divisions.clear();
+			move_requests.clear();
+			for(ProvinceHandle handle : command.provinces)
+			{
+				divisions.forEachStationed(handle, [&](DivisionId id)
+				{
+					if(divisions.getOwner(id) != command.country) return;
+
+					move_divisions.push_back(id);
+					move_requests.push_back({handle, command.destination});
+				});
+			}
+			if(move_divisions.empty()) return;
+
+			move_paths.resize(move_requests.size());
+			pathfinder.findPaths(move_requests.data(), move_requests.size(), move_paths.data(), jobs);
+
+			for(size_t i = 0; i < move_divisions.size(); ++i) divisions.order(move_divisions[i], move_paths[i]);
+		}
+
+		// Collected first, disbanding unlinks divisions from the stationed lists being walked
+		void orderDisband(const SimCommand& command)
+		{
+			move_divisions.clear();
+			for(ProvinceHandle handle : command.provinces)
+			{
+				divisions.forEachStationed(handle, [&](DivisionId id)
+				{
+					if(divisions.getOwner(id) == command.country) move_divisions.push_back(id);
+				});
+			}
+
+			for(DivisionId id : move_divisions) divisions.disband(id);
+		}
+
+		void publish(uint64_t taken)
+		{
+			SimSnapshot& slot = slots[back];
+			slot.tick = tick;
+			slot.ticks_per_second = ticks_per_second;
+
+			// Slots keep their owner array between uses, it's only copied when it's out of date
+			if(slot.owner_version != owner_version)
+			{
+				slot.owners = owners;
+				slot.owner_version = owner_version;
+			}
+			divisions.copyTo(slot.divisions);
+
+			if(slot.supply_version != supply_version)
+			{
+				slot.supply = supply.getSupply();
+				slot.supply_version = supply_version;
+			}
+			slot.economy = economy.getCountryTotals();
+
+			uint32_t previous = middle.exchange(back | FRESH);
+			back = previous & INDEX;
+			applied_commands.store(taken);
+
+			// Only wake the renderer once it has taken the last snapshot, uncapped ticks would flood its event queue
+			if(on_publish && !(previous & FRESH)) on_publish();
+		}
+};
@@ -0,0 +1,191 @@
+#pragma once
+
+#include "province.hpp"
+#include <algorithm>
+#include <cmath>
+#include <iostream>
+
+// One province ring registered in the grid
+struct GridEntry
+{
+	ProvinceHandle province;
+	uint32_t polygon;		// Into Province::polygons
+	Rectangle bounds;
+};
+
+// Uniform grid over the ring bounds, built once at load. Every cell lists the rings whose bounds touch it
+// (CSR layout, in province order), so a point query only looks at a handful of candidates.
+class SpatialGrid
+{
+	public:
+		static constexpr int MAX_CELLS_PER_AXIS = 1024;
+		static constexpr float ENTRIES_PER_CELL = 2.0f;	// Target average, decides the cell size
+
+		void build(const vector<Province>& provinces)
+		{
+			entries.clear();
+			cell_start.clear();
+
+			// Same rings as Province::polygon_bounds, which skips empty polygons
+			vector<GridEntry> rings;
+			float minX = 1e30f, minY = 1e30f, maxX = -1e30f, maxY = -1e30f;
+
+			for(ProvinceHandle handle = 0; handle < provinces.size(); ++handle)
+			{
+				const Province& province = provinces[handle];
+				size_t bounds_index = 0;
+
+				for(uint32_t poly_index = 0; poly_index < province.polygons.size(); ++poly_index)
+				{
+					if(province.polygons[poly_index].empty()) continue;
+					if(bounds_index >= province.polygon_bounds.size()) break;
+
+					const Rectangle& bounds = province.polygon_bounds[bounds_index++];
+					rings.push_back({handle, poly_index, bounds});
+
+					minX = min(minX, bounds.x);
+					minY = min(minY, bounds.y);
+					maxX = max(maxX, bounds.x + bounds.width);
+					maxY = max(maxY, bounds.y + bounds.height);
+				}
+			}
+
+			if(rings.empty())
+			{
+				area = {0, 0, 0, 0};
+				cols = rows = 0;
+				return;
+			}
+
+			area = {minX, minY, max(maxX - minX, 1e-3f), max(maxY - minY, 1e-3f)};
+
+			// Square-ish cells, about ENTRIES_PER_CELL rings each
+			float target = max(1.0f, rings.size() / ENTRIES_PER_CELL);
+			float aspect = area.width / area.height;
+			cols = clamp((int)roundf(sqrtf(target * aspect)), 1, MAX_CELLS_PER_AXIS);
+			rows = clamp((int)roundf(sqrtf(target / aspect)), 1, MAX_CELLS_PER_AXIS);
+			cell_width = area.width / cols;
+			cell_height = area.height / rows;
+
+			// Count, prefix sum, fill
+			cell_start.assign((size_t)cols * rows + 1, 0);
+
+			for(const auto& ring : rings)
+			{
+				int x0, y0, x1, y1;
+				cellRange(ring.bounds, x0, y0, x1, y1);
+				for(int y = y0; y <= y1; ++y)
+				{
+					for(int x = x0; x <= x1; ++x) cell_start[(size_t)y * cols + x + 1]++;
+				}
+			}
+
+			for(size_t c = 1; c < cell_start.size(); ++c) cell_start[c] += cell_start[c - 1];
+
+			entries.resize(cell_start.back());
+			vector<uint32_t> cursor(cell_start.begin(), cell_start.end() - 1);
+
+			for(const auto& ring : rings)
+			{
+				int x0, y0, x1, y1;
+				cellRange(ring.bounds, x0, y0, x1, y1);
+				for(int y = y0; y <= y1; ++y)
+				{
+					for(int x = x0; x <= x1; ++x) entries[cursor[(size_t)y * cols + x]++] = ring;
+				}
+			}
+
+			cout << "Built " << cols << "x" << rows << " spatial grid (" << rings.size() << " rings, " << entries.size() << " cell entries)" << endl;
+		}
+
+		// Candidate rings for a point, [first, last). Empty outside the map.
+		pair<const GridEntry*, const GridEntry*> getCandidates(Vector2 point) const
+		{
+			if(cols == 0 || point.x < area.x || point.y < area.y || point.x > area.x + area.width || point.y > area.y + area.height)
+			{
+				return {nullptr, nullptr};
+			}
+
+			int x = min((int)((point.x - area.x) / cell_width), cols - 1);
+			int y = min((int)((point.y - area.y) / cell_height), rows - 1);
+			size_t cell = (size_t)y * cols + x;
+
+			return {entries.data() + cell_start[cell], entries.data() + cell_start[cell + 1]};
+		}
+
+		// Rings whose bounds overlap an area, each ring once, in province order
+		void queryRect(const Rectangle& rect, vector<const GridEntry*>& out) const
+		{
+			out.clear();
+			if(cols == 0 || !boundsOverlap(rect, area)) return;
+
+			int x0, y0, x1, y1;
+			cellRange(rect, x0, y0, x1, y1);
+
+			for(int y = y0; y <= y1; ++y)
+			{
+				for(int x = x0; x <= x1; ++x)
+				{
+					size_t cell = (size_t)y * cols + x;
+					for(uint32_t e = cell_start[cell]; e < cell_start[cell + 1]; ++e)
+					{
+						if(boundsOverlap(entries[e].bounds, rect)) out.push_back(&entries[e]);
+					}
+				}
+			}
+
+			// Rings spanning several cells were found more than once
+			auto order = [](const GridEntry* a, const GridEntry* b)
+			{
+				return a->province != b->province ? a->province < b->province : a->polygon < b->polygon;
+			};
+			auto same = [](const GridEntry* a, const GridEntry* b) { return a->province == b->province && a->polygon == b->polygon; };
+
+			sort(out.begin(), out.end(), order);
+			out.erase(unique(out.begin(), out.end(), same), out.end());
+		}
+
+		// Cell a point falls in, the same one getCandidates uses (clamped for points off the map)
+		size_t getCellIndex(Vector2 point) const
+		{
+			if(cols == 0) return 0;
+
+			int x = clamp((int)((point.x - area.x) / cell_width), 0, cols - 1);
+			int y = clamp((int)((point.y - area.y) / cell_height), 0, rows - 1);
+			return (size_t)y * cols + x;
+		}
+
+		float getCellSize() const { return max(cell_width, cell_height); }
+
+		static bool boundsContain(const Rectangle& bounds, Vector2 point)
+		{
+			return point.x >= bounds.x && point.y >= bounds.y && point.x <= bounds.x + bounds.width && point.y <= bounds.y + bounds.height;
+		}
+
+		// Touching counts, unlike CheckCollisionRecs
+		static bool boundsOverlap(const Rectangle& a, const Rectangle& b)
+		{
+			return a.x <= b.x + b.width && b.x <= a.x + a.width && a.y <= b.y + b.height && b.y <= a.y + a.height;
+		}
+
+		const Rectangle& getArea() const { return area; }
+		int getColumns() const { return cols; }
+		int getRows() const { return rows; }
+		size_t getEntryCount() const { return entries.size(); }
+
+	private:
+		Rectangle area = {0, 0, 0, 0};
+		int cols = 0, rows = 0;
+		float cell_width = 1.0f, cell_height = 1.0f;
+
+		vector<uint32_t> cell_start;	// cols * rows + 1 offsets into entries
+		vector<GridEntry> entries;
+
+		void cellRange(const Rectangle& bounds, int& x0, int& y0, int& x1, int& y1) const
+		{
+			x0 = clamp((int)((bounds.x - area.x) / cell_width), 0, cols - 1);
+			y0 = clamp((int)((bounds.y - area.y) / cell_height), 0, rows - 1);
+			x1 = clamp((int)((bounds.x + bounds.width - area.x) / cell_width), 0, cols - 1);
+			y1 = clamp((int)((bounds.y + bounds.height - area.y) / cell_height), 0, rows - 1);
+		}
+};
@@ -0,0 +1,225 @@
+#pragma once
+
+#include "province.hpp"
+#include "ownership.hpp"
+#include "province_graph.hpp"
+#include "job_system.hpp"
+#include <algorithm>
+#include <iostream>
+
+// Supply flowing out of depots through the provinces of the depot's owner, losing some of it with every
+// province it crosses. Every country is its own region: supply never crosses a border, so countries are
+// propagated independently (in parallel) and only the ones touched since the last update are redone.
+class SupplyNetwork
+{
+	public:
+		static constexpr float DEPOT_SUPPLY = 1.0f;
+		static constexpr float HOP_LOSS = 0.08f;	// Supply lost crossing an open flat province
+
+		// Depots go into the most urban provinces (NUTS urban type 1), and into the most urban province of
+		// countries that have none of those
+		void build(const vector<Province>& provinces, const ProvinceGraph& province_graph, const vector<CountryId>& owners)
+		{
+			graph = &province_graph;
+			owner_of = owners;
+
+			costs.resize(provinces.size());
+			for(ProvinceHandle handle = 0; handle < provinces.size(); ++handle) costs[handle] = hopCost(provinces[handle]);
+
+			supply.assign(provinces.size(), 0.0f);
+			depots.assign(provinces.size(), 0);
+			member_index.assign(provinces.size(), 0);
+			members.clear();
+			dirty.clear();
+			country_dirty.clear();
+
+			for(ProvinceHandle handle = 0; handle < provinces.size(); ++handle) addMember(owners[handle], handle);
+
+			for(CountryId country = 0; country < members.size(); ++country)
+			{
+				ProvinceHandle best = INVALID_PROVINCE;
+				int best_urban = INT32_MAX;
+				bool has_city = false;
+
+				for(ProvinceHandle handle : members[country])
+				{
+					int urban = (int)lroundf(provinces[handle].urban_type);
+					if(urban == 1)
+					{
+						depots[handle] = 1;
+						has_city = true;
+					}
+					else if(urban >= 1 && urban < best_urban)
+					{
+						best = handle;
+						best_urban = urban;
+					}
+				}
+
+				if(!has_city && !members[country].empty()) depots[best != INVALID_PROVINCE ? best : members[country].front()] = 1;
+				markDirty(country);
+			}
+
+			size_t depot_count = count(depots.begin(), depots.end(), 1);
+			cout << "Built supply network: " << depot_count << " depots" << endl;
+		}
+
+		// Cost of passing supply through a province, 1 on open flat land. Mountains choke it, cities carry it.
+		static float hopCost(const Province& province)
+		{
+			float cost = 1.0f;
+
+			int mountain = (int)lroundf(province.mountain_type);
+			if(mountain >= 1 && mountain <= 3) cost *= 1.0f + (4 - mountain) * 0.5f;
+
+			int urban = (int)lroundf(province.urban_type);
+			if(urban >= 1 && urban <= 3) cost *= 1.0f - (4 - urban) * 0.15f;
+
+			return cost;
+		}
+
+		// Both countries are redone on the next update
+		void setOwner(ProvinceHandle handle, CountryId owner)
+		{
+			if(handle >= owner_of.size() || owner_of[handle] == owner) return;
+
+			CountryId old_owner = owner_of[handle];
+			removeMember(old_owner, handle);
+			addMember(owner, handle);
+			owner_of[handle] = owner;
+
+			markDirty(old_owner);
+			markDirty(owner);
+		}
+
+		void setDepot(ProvinceHandle handle, bool depot)
+		{
+			if(handle >= depots.size() || (depots[handle] != 0) == depot) return;
+
+			depots[handle] = depot ? 1 : 0;
+			markDirty(owner_of[handle]);
+		}
+
+		bool isDepot(ProvinceHandle handle) const { return handle < depots.size() && depots[handle]; }
+
+		// 0..1 per province handle
+		const vector<float>& getSupply() const { return supply; }
+		float getSupply(ProvinceHandle handle) const { return handle < supply.size() ? supply[handle] : 0.0f; }
+
+		bool needsUpdate() const { return !dirty.empty(); }
+
+		// Propagates the countries changed since the last call, one country per work item.
+		// Returns how many were redone.
+		size_t update(JobSystem& jobs)
+		{
+			if(dirty.empty()) return 0;
+
+			if(scratch.size() < jobs.getThreadCount()) scratch.resize(jobs.getThreadCount());
+
+			jobs.parallelFor(dirty.size(), 1, [&](size_t begin, size_t end, unsigned worker)
+			{
+				for(size_t i = begin; i < end; ++i) propagate(dirty[i], scratch[worker]);
+			});
+
+			for(CountryId country : dirty) country_dirty[country] = 0;
+
+			size_t count = dirty.size();
+			dirty.clear();
+			return count;
+		}
+
+	private:
+		struct Scratch
+		{
+			vector<pair<float, ProvinceHandle>> heap;	// Cost so far, province
+		};
+
+		const ProvinceGraph* graph = nullptr;
+
+		vector<CountryId> owner_of;
+		vector<float> costs;
+		vector<float> supply;
+		vector<uint8_t> depots;
+
+		// Provinces of every country, so a country can be cleared without a pass over the map
+		vector<vector<ProvinceHandle>> members;
+		vector<uint32_t> member_index;		// Position in its country's member list
+
+		vector<CountryId> dirty;
+		vector<uint8_t> country_dirty;
+
+		vector<Scratch> scratch;
+
+		void addMember(CountryId country, ProvinceHandle handle)
+		{
+			if(country >= members.size()) members.resize((size_t)country + 1);
+
+			member_index[handle] = (uint32_t)members[country].size();
+			members[country].push_back(handle);
+		}
+
+		void removeMember(CountryId country, ProvinceHandle handle)
+		{
+			auto& list = members[country];
+			uint32_t index = member_index[handle];
+
+			list[index] = list.back();
+			member_index[list[index]] = index;
+			list.pop_back();
+		}
+
+		void markDirty(CountryId country)
+		{
+			if(country >= country_dirty.size()) country_dirty.resize((size_t)country + 1, 0);
+			if(country_dirty[country]) return;
+
+			country_dirty[country] = 1;
+			dirty.push_back(country);
+		}
+
+		// Multi source Dijkstra from the country's depots, over its own provinces only. Countries own disjoint
+		// provinces, so workers never write the same entries.
+		void propagate(CountryId country, Scratch& s)
+		{
+			if(country >= members.size()) return;
+
+			const auto& list = members[country];
+			for(ProvinceHandle handle : list) supply[handle] = 0.0f;
+
+			auto later = [](const pair<float, ProvinceHandle>& a, const pair<float, ProvinceHandle>& b) { return a.first > b.first; };
+
+			s.heap.clear();
+			for(ProvinceHandle handle : list)
+			{
+				if(!depots[handle]) continue;
+
+				supply[handle] = DEPOT_SUPPLY;
+				s.heap.push_back({0.0f, handle});
+			}
+			make_heap(s.heap.begin(), s.heap.end(), later);
+
+			// Supply doubles as the visited mark: a province is settled once its supply can't get any better
+			while(!s.heap.empty())
+			{
+				pop_heap(s.heap.begin(), s.heap.end(), later);
+				float cost = s.heap.back().first;
+				ProvinceHandle handle = s.heap.back().second;
+				s.heap.pop_back();
+
+				if(DEPOT_SUPPLY - cost < supply[handle]) continue;
+
+				for(ProvinceHandle neighbour : graph->getNeighbours(handle))
+				{
+					if(owner_of[neighbour] != country) continue;
+
+					float next_cost = cost + HOP_LOSS * 0.5f * (costs[handle] + costs[neighbour]);
+					float value = DEPOT_SUPPLY - next_cost;
+					if(value <= supply[neighbour]) continue;
+
+					supply[neighbour] = value;
+					s.heap.push_back({next_cost, neighbour});
+					push_heap(s.heap.begin(), s.heap.end(), later);
+				}
+			}
+		}
+};
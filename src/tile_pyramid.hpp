@@ -0,0 +1,288 @@
+#pragma once
+
+#include "raylib.h"
+#include "rlgl.h"
+#include <unordered_map>
+#include <list>
+#include <vector>
+#include <algorithm>
+#include <cmath>
+
+using namespace std;
+
+// Pre-rendered raster tiles of the map for low zoom levels.
+// Level 0 is rendered at zoom 1, every further level at half the zoom of the previous one.
+class TilePyramid
+{
+	public:
+		static constexpr int TILE_SIZE = 256;		// Pixels per tile side
+		static constexpr int LEVEL_COUNT = 4;		// Zoom 1, 1/2, 1/4, 1/8
+		static constexpr float MAX_ZOOM = 1.0f;		// Tiles are only used below this zoom
+
+		~TilePyramid() {}
+
+		void setCapacity(size_t tiles) { capacity = max<size_t>(tiles, 1); }
+		void setTilesPerFrame(int tiles) { tiles_per_frame = max(tiles, 1); }
+
+		size_t getCachedCount() const { return tiles.size(); }
+		int getRasterizedLastFrame() const { return rasterized_last_frame; }
+
+		// Visible tiles were left for later frames by the per frame budget
+		bool hasPendingTiles() const { return pending_last_frame > 0; }
+
+		// Must be called while the GL context is still alive
+		void unload()
+		{
+			for(auto& entry : tiles) UnloadRenderTexture(entry.second.target);
+			for(auto& target : spare) UnloadRenderTexture(target);
+
+			tiles.clear();
+			spare.clear();
+			lru.clear();
+		}
+
+		static int levelForZoom(float zoom)
+		{
+			// Highest level whose resolution is still at least the screen resolution
+			int level = (int)floorf(-log2f(max(zoom, 1e-6f)));
+			return min(max(level, 0), LEVEL_COUNT - 1);
+		}
+
+		static float levelScale(int level) { return 1.0f / (float)(1 << level); }
+		static float worldTileSize(int level) { return TILE_SIZE / levelScale(level); }
+
+		// Tiles touching a world area need a redraw (province colour changed there)
+		void markStale(const Rectangle& area)
+		{
+			for(auto& entry : tiles)
+			{
+				if(CheckCollisionRecs(entry.second.bounds, area)) entry.second.stale = true;
+			}
+		}
+
+		// Every tile needs a redraw (background or map mode changed)
+		void markAllStale()
+		{
+			for(auto& entry : tiles) entry.second.stale = true;
+		}
+
+		// Rasterizes some of the visible tiles that are missing or stale, closest to the view centre first.
+		// rasterize(camera, area) must draw the map with the given camera, culled to the world space area.
+		template<typename DrawFn>
+		void update(const Rectangle& view, float zoom, Color background, DrawFn rasterize)
+		{
+			frame++;
+			rasterized_last_frame = 0;
+			pending_last_frame = 0;
+
+			int level = levelForZoom(zoom);
+			float size = worldTileSize(level);
+
+			int x0, y0, x1, y1;
+			tileRange(view, size, x0, y0, x1, y1);
+
+			Vector2 centre = { view.x + view.width / 2, view.y + view.height / 2 };
+
+			// Collect what needs rasterizing and touch everything visible so it won't get evicted
+			vector<PendingTile> pending;
+
+			for(int ty = y0; ty <= y1; ++ty)
+			{
+				for(int tx = x0; tx <= x1; ++tx)
+				{
+					uint64_t key = tileKey(level, tx, ty);
+					auto it = tiles.find(key);
+
+					if(it != tiles.end())
+					{
+						touch(it->second);
+						if(!it->second.stale) continue;
+					}
+
+					float dx = (tx + 0.5f) * size - centre.x;
+					float dy = (ty + 0.5f) * size - centre.y;
+					pending.push_back({ dx * dx + dy * dy, tx, ty });
+				}
+			}
+
+			if(pending.empty()) return;
+
+			sort(pending.begin(), pending.end(), [](const PendingTile& a, const PendingTile& b) { return a.distance < b.distance; });
+
+			for(const auto& item : pending)
+			{
+				if(rasterized_last_frame >= tiles_per_frame) break;
+
+				Tile* tile = acquire(level, item.tx, item.ty, size);
+				if(!tile) return; // Cache is full of tiles visible this frame, more frames won't help
+
+				Camera2D tile_camera = {};
+				tile_camera.target = { tile->bounds.x, tile->bounds.y };
+				tile_camera.zoom = levelScale(level);
+
+				BeginTextureMode(tile->target);
+				ClearBackground(background);
+
+				BeginMode2D(tile_camera);
+				rasterize(tile_camera, tile->bounds);
+				EndMode2D();
+
+				EndTextureMode();
+
+				tile->stale = false;
+				rasterized_last_frame++;
+			}
+
+			pending_last_frame = (int)pending.size() - rasterized_last_frame;
+		}
+
+		// World space bounds of the visible tiles that can't be drawn from the cache.
+		// Returns false if every visible tile is available.
+		bool getMissingBounds(const Rectangle& view, float zoom, Rectangle& missing) const
+		{
+			int level = levelForZoom(zoom);
+			float size = worldTileSize(level);
+
+			int x0, y0, x1, y1;
+			tileRange(view, size, x0, y0, x1, y1);
+
+			float minX = 1e30f, minY = 1e30f, maxX = -1e30f, maxY = -1e30f;
+			bool any = false;
+
+			for(int ty = y0; ty <= y1; ++ty)
+			{
+				for(int tx = x0; tx <= x1; ++tx)
+				{
+					auto it = tiles.find(tileKey(level, tx, ty));
+					if(it != tiles.end() && !it->second.stale) continue;
+
+					minX = min(minX, tx * size);
+					minY = min(minY, ty * size);
+					maxX = max(maxX, (tx + 1) * size);
+					maxY = max(maxY, (ty + 1) * size);
+					any = true;
+				}
+			}
+
+			if(any) missing = { minX, minY, maxX - minX, maxY - minY };
+			return any;
+		}
+
+		// Draws every visible up to date tile (inside BeginMode2D)
+		void draw(const Rectangle& view, float zoom)
+		{
+			int level = levelForZoom(zoom);
+			float size = worldTileSize(level);
+
+			int x0, y0, x1, y1;
+			tileRange(view, size, x0, y0, x1, y1);
+
+			// Tiles are opaque but their alpha channel isn't (translucent fills), so copy them without blending
+			rlDrawRenderBatchActive();
+			rlDisableColorBlend();
+
+			for(int ty = y0; ty <= y1; ++ty)
+			{
+				for(int tx = x0; tx <= x1; ++tx)
+				{
+					auto it = tiles.find(tileKey(level, tx, ty));
+					if(it == tiles.end() || it->second.stale) continue;
+
+					// Render textures are stored upside down
+					DrawTexturePro(it->second.target.texture, {0, 0, (float)TILE_SIZE, -(float)TILE_SIZE}, it->second.bounds, {0, 0}, 0.0f, WHITE);
+				}
+			}
+
+			rlDrawRenderBatchActive();
+			rlEnableColorBlend();
+		}
+
+	private:
+		struct Tile
+		{
+			RenderTexture2D target;
+			Rectangle bounds;
+			bool stale;
+			uint64_t last_used;
+			list<uint64_t>::iterator lru_position;
+		};
+
+		struct PendingTile
+		{
+			float distance;
+			int tx, ty;
+		};
+
+		unordered_map<uint64_t, Tile> tiles;
+		list<uint64_t> lru;					// Most recently used first
+		vector<RenderTexture2D> spare;		// Evicted render textures, reused for new tiles
+
+		size_t capacity = 128;
+		int tiles_per_frame = 2;
+
+		uint64_t frame = 0;
+		int rasterized_last_frame = 0;
+		int pending_last_frame = 0;
+
+		static uint64_t tileKey(int level, int tx, int ty)
+		{
+			return ((uint64_t)(uint8_t)level << 56) | ((uint64_t)((uint32_t)tx & 0x0FFFFFFF) << 28) | (uint64_t)((uint32_t)ty & 0x0FFFFFFF);
+		}
+
+		static void tileRange(const Rectangle& view, float size, int& x0, int& y0, int& x1, int& y1)
+		{
+			x0 = (int)floorf(view.x / size);
+			y0 = (int)floorf(view.y / size);
+			x1 = (int)floorf((view.x + view.width) / size);
+			y1 = (int)floorf((view.y + view.height) / size);
+		}
+
+		void touch(Tile& tile)
+		{
+			tile.last_used = frame;
+			lru.splice(lru.begin(), lru, tile.lru_position);
+		}
+
+		// Finds or creates the tile for a key, evicting the least recently used tile if the cache is full
+		Tile* acquire(int level, int tx, int ty, float size)
+		{
+			uint64_t key = tileKey(level, tx, ty);
+
+			auto it = tiles.find(key);
+			if(it != tiles.end()) return &it->second;
+
+			RenderTexture2D target;
+
+			if(tiles.size() >= capacity)
+			{
+				auto victim = tiles.find(lru.back());
+				if(victim->second.last_used == frame) return nullptr;
+
+				spare.push_back(victim->second.target);
+				tiles.erase(victim);
+				lru.pop_back();
+			}
+
+			if(!spare.empty())
+			{
+				target = spare.back();
+				spare.pop_back();
+			}
+			else
+			{
+				target = LoadRenderTexture(TILE_SIZE, TILE_SIZE);
+				SetTextureFilter(target.texture, TEXTURE_FILTER_BILINEAR);
+			}
+
+			lru.push_front(key);
+
+			Tile tile;
+			tile.target = target;
+			tile.bounds = { tx * size, ty * size, size, size };
+			tile.stale = true;
+			tile.last_used = frame;
+			tile.lru_position = lru.begin();
+
+			return &tiles.emplace(key, tile).first->second;
+		}
+};
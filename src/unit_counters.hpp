@@ -0,0 +1,375 @@
+#pragma once
+
+#include "province.hpp"
+#include "ownership.hpp"
+#include "divisions.hpp"
+#include "spatial_grid.hpp"
+#include "frame_profiler.hpp"
+#include "rlgl.h"
+#include "raymath.h"
+#include <algorithm>
+#include <iostream>
+
+#define UNITCOUNTERS_ERR "LakyStrategy::UnitCounters::Error: "
+
+// One quad shared by every counter, the instance attributes place and fill it. Counters keep their pixel size
+// at any zoom, like the borders.
+static const char* UNIT_COUNTERS_VS = R"(
+#version 330
+
+layout(location = 0) in vec2 vertexPosition;	// Quad corner, 0..1
+layout(location = 6) in vec2 instancePosition;
+layout(location = 7) in vec4 instanceColor;
+layout(location = 8) in vec4 instanceData;		// Icon index, strength, organisation (0..255)
+
+uniform mat4 mvp;
+uniform vec2 halfSize;		// World units
+
+out vec2 fragUv;
+out vec4 fragColor;
+out vec3 fragData;
+
+void main()
+{
+	fragUv = vertexPosition;
+	fragColor = instanceColor;
+	fragData = vec3(instanceData.x, instanceData.yz / 255.0);
+	gl_Position = mvp * vec4(instancePosition + (vertexPosition * 2.0 - 1.0) * halfSize, 0.0, 1.0);
+}
+)";
+
+// Top part: the country colour with the type icon from the atlas on it. Bottom strip: the strength bar.
+static const char* UNIT_COUNTERS_FS = R"(
+#version 330
+
+in vec2 fragUv;
+in vec4 fragColor;
+in vec3 fragData;
+
+uniform sampler2D atlas;
+uniform float iconCount;
+
+out vec4 finalColor;
+
+const float BAR = 0.25;		// Share of the height
+const float EDGE = 0.06;
+
+void main()
+{
+	if(fragUv.x < EDGE || fragUv.x > 1.0 - EDGE || fragUv.y < EDGE || fragUv.y > 1.0 - EDGE)
+	{
+		finalColor = vec4(0.1, 0.1, 0.1, 1.0);
+		return;
+	}
+
+	if(fragUv.y > 1.0 - BAR)
+	{
+		float filled = (fragUv.x - EDGE) / (1.0 - 2.0 * EDGE);
+		finalColor = filled <= fragData.y ? mix(vec4(0.8, 0.2, 0.1, 1.0), vec4(0.2, 0.8, 0.2, 1.0), fragData.z) : vec4(0.2, 0.2, 0.2, 1.0);
+		return;
+	}
+
+	vec2 uv = vec2((fragData.x + fragUv.x) / iconCount, fragUv.y / (1.0 - BAR));
+	vec4 icon = texture(atlas, uv);
+	finalColor = vec4(mix(fragColor.rgb, vec3(0.1), icon.a), 1.0);
+}
+)";
+
+// Draws every visible division as a counter in one instanced call. The instance buffers are rebuilt each frame
+// from the province interior points, culled with the province grid, and grow only when they run out of room.
+// One buffer per attribute, so none of them needs an offset into an interleaved layout.
+class UnitCounters
+{
+	public:
+		static constexpr float COUNTER_WIDTH = 22.0f;		// Pixels
+		static constexpr float COUNTER_HEIGHT = 16.0f;
+		static constexpr float STACK_OFFSET = 5.0f;		// Pixels between counters in the same province
+		static constexpr uint32_t MAX_STACK = 4;			// Counters shown per province, the rest hide under them
+		static constexpr int ICON_SIZE = 32;				// Atlas pixels per icon
+
+		// Attribute locations, matching the vertex shader
+		static constexpr int ATTRIB_CORNER = 0;
+		static constexpr int ATTRIB_POSITION = 6;
+		static constexpr int ATTRIB_COLOR = 7;
+		static constexpr int ATTRIB_DATA = 8;
+
+		// Forgets the stacks of the previous map
+		void init(size_t province_count)
+		{
+			province_stamp.assign(province_count, 0);
+			province_stack.assign(province_count, 0);
+			stamp = 0;
+		}
+
+		// GPU side, needs the GL context
+		void upload()
+		{
+			uploaded = true;
+
+			shader = LoadShaderFromMemory(UNIT_COUNTERS_VS, UNIT_COUNTERS_FS);
+			if(shader.id == 0 || shader.id == rlGetShaderIdDefault())
+			{
+				cerr << UNITCOUNTERS_ERR << "Failed to compile the unit counter shader, counters are not drawn" << endl;
+				return;
+			}
+
+			mvp_loc = GetShaderLocation(shader, "mvp");
+			half_size_loc = GetShaderLocation(shader, "halfSize");
+			atlas_loc = GetShaderLocation(shader, "atlas");
+			icon_count_loc = GetShaderLocation(shader, "iconCount");
+
+			vector<Color> pixels = buildAtlas();
+			Image image = { pixels.data(), ICON_SIZE * DIVISION_TYPE_COUNT, ICON_SIZE, 1, PIXELFORMAT_UNCOMPRESSED_R8G8B8A8 };
+			atlas = LoadTextureFromImage(image);
+			SetTextureFilter(atlas, TEXTURE_FILTER_BILINEAR);
+
+			static const Vector2 CORNERS[6] = { {0, 0}, {0, 1}, {1, 0}, {1, 0}, {0, 1}, {1, 1} };
+
+			vao = rlLoadVertexArray();
+			rlEnableVertexArray(vao);
+
+			corner_vbo = rlLoadVertexBuffer(CORNERS, (int)sizeof(CORNERS), false);
+			rlSetVertexAttribute(ATTRIB_CORNER, 2, RL_FLOAT, false, 0, 0);
+			rlEnableVertexAttribute(ATTRIB_CORNER);
+
+			rlDisableVertexArray();
+
+			ready = true;
+		}
+
+		// Must be called while the GL context is still alive
+		void unload()
+		{
+			if(!uploaded) return;
+
+			if(ready)
+			{
+				rlUnloadVertexArray(vao);
+				rlUnloadVertexBuffer(corner_vbo);
+				for(unsigned int vbo : instance_vbos) if(vbo != 0) rlUnloadVertexBuffer(vbo);
+				UnloadTexture(atlas);
+			}
+			if(shader.id != 0) UnloadShader(shader);
+
+			shader = {};
+			atlas = {};
+			for(unsigned int& vbo : instance_vbos) vbo = 0;
+			instance_capacity = 0;
+			ready = false;
+			uploaded = false;
+		}
+
+		bool isUploaded() const { return uploaded; }
+		bool isReady() const { return ready; }
+
+		// Fills the instance array with the divisions in or heading into a province that touches the area.
+		// Returns the number of counters.
+		size_t update(const DivisionSnapshot& divisions, const vector<Province>& provinces, const SpatialGrid& grid,
+			const vector<Country>& countries, const Rectangle& area, float zoom)
+		{
+			positions.clear();
+			colors.clear();
+			data.clear();
+			if(divisions.ids.empty() || province_stamp.size() != provinces.size()) return 0;
+
+			// A new stamp marks this frame's visible provinces and restarts their stacks
+			if(++stamp == 0)
+			{
+				fill(province_stamp.begin(), province_stamp.end(), 0);
+				stamp = 1;
+			}
+
+			// Counters stick out of their province, so the query is grown by one counter
+			float pad_x = COUNTER_WIDTH / zoom, pad_y = (COUNTER_HEIGHT + STACK_OFFSET * MAX_STACK) / zoom;
+			grid.queryRect({ area.x - pad_x, area.y - pad_y, area.width + pad_x * 2, area.height + pad_y * 2 }, candidates);
+
+			for(const GridEntry* entry : candidates)
+			{
+				province_stamp[entry->province] = stamp;
+				province_stack[entry->province] = 0;
+			}
+
+			for(size_t i = 0; i < divisions.ids.size(); ++i)
+			{
+				ProvinceHandle province = divisions.provinces[i];
+				ProvinceHandle next = divisions.next_provinces[i];
+
+				bool visible = province_stamp[province] == stamp || (next != INVALID_PROVINCE && province_stamp[next] == stamp);
+				if(!visible) continue;
+
+				Vector2 position = provinces[province].interior_point;
+				if(next != INVALID_PROVINCE)
+				{
+					position = Vector2Lerp(position, provinces[next].interior_point, divisions.progress[i]);
+				}
+				else
+				{
+					// Standing divisions stack up, each one a bit higher than the last
+					uint32_t& stack = province_stack[province];
+					if(stack >= MAX_STACK) continue;
+
+					position.y -= stack * STACK_OFFSET / zoom;
+					stack++;
+				}
+
+				Color color = divisions.owners[i] < countries.size() ? countries[divisions.owners[i]].color : GRAY;
+				color.a = 255;
+
+				positions.push_back(position);
+				colors.push_back(color);
+				data.push_back({
+					(unsigned char)divisions.types[i],
+					(unsigned char)(Clamp(divisions.strength[i], 0.0f, 1.0f) * 255.0f),
+					(unsigned char)(Clamp(divisions.organisation[i], 0.0f, 1.0f) * 255.0f),
+					0
+				});
+			}
+
+			return positions.size();
+		}
+
+		// Uploads the instances of the last update and draws them (inside BeginMode2D)
+		void draw(float zoom, FrameProfiler* profiler = nullptr)
+		{
+			if(!ready || positions.empty()) return;
+
+			rlDrawRenderBatchActive();
+
+			rlEnableVertexArray(vao);
+			uploadInstances();
+
+			Matrix mvp = MatrixMultiply(MatrixMultiply(rlGetMatrixTransform(), rlGetMatrixModelview()), rlGetMatrixProjection());
+			Vector2 half_size = { COUNTER_WIDTH * 0.5f / max(zoom, 1e-6f), COUNTER_HEIGHT * 0.5f / max(zoom, 1e-6f) };
+			float icon_count = (float)DIVISION_TYPE_COUNT;
+			int atlas_slot = 0;
+
+			rlEnableShader(shader.id);
+			rlSetUniformMatrix(mvp_loc, mvp);
+			rlSetUniform(half_size_loc, &half_size, RL_SHADER_UNIFORM_VEC2, 1);
+			rlSetUniform(icon_count_loc, &icon_count, RL_SHADER_UNIFORM_FLOAT, 1);
+			rlSetUniform(atlas_loc, &atlas_slot, RL_SHADER_UNIFORM_INT, 1);
+
+			rlActiveTextureSlot(0);
+			rlEnableTexture(atlas.id);
+
+			rlDrawVertexArrayInstanced(0, 6, (int)positions.size());
+
+			rlDisableTexture();
+			rlDisableVertexArray();
+			rlDisableShader();
+
+			if(profiler) profiler->addDraw((uint32_t)positions.size() * 2, (uint32_t)positions.size() * 6, 0);
+		}
+
+		size_t getInstanceCount() const { return positions.size(); }
+
+	private:
+		enum InstanceBuffer { INSTANCE_POSITION, INSTANCE_COLOR, INSTANCE_DATA, INSTANCE_BUFFER_COUNT };
+
+		// Instance attributes of the last update
+		vector<Vector2> positions;
+		vector<Color> colors;
+		vector<Color> data;		// Icon, strength, organisation, unused (not a colour, same four bytes)
+
+		// Per province, valid when its stamp is the current one
+		vector<uint32_t> province_stamp;
+		vector<uint32_t> province_stack;
+		uint32_t stamp = 0;
+
+		vector<const GridEntry*> candidates;
+
+		Shader shader = {};
+		int mvp_loc = -1;
+		int half_size_loc = -1;
+		int atlas_loc = -1;
+		int icon_count_loc = -1;
+		Texture2D atlas = {};
+
+		unsigned int vao = 0;
+		unsigned int corner_vbo = 0;
+		unsigned int instance_vbos[INSTANCE_BUFFER_COUNT] = {};
+		size_t instance_capacity = 0;	// Instances the buffers have room for
+
+		bool uploaded = false;
+		bool ready = false;
+
+		// Sub-buffer updates while the instances fit, bigger buffers (half again) when they don't. The VAO is bound.
+		void uploadInstances()
+		{
+			size_t count = positions.size();
+
+			if(count <= instance_capacity)
+			{
+				rlUpdateVertexBuffer(instance_vbos[INSTANCE_POSITION], positions.data(), (int)(count * sizeof(Vector2)), 0);
+				rlUpdateVertexBuffer(instance_vbos[INSTANCE_COLOR], colors.data(), (int)(count * sizeof(Color)), 0);
+				rlUpdateVertexBuffer(instance_vbos[INSTANCE_DATA], data.data(), (int)(count * sizeof(Color)), 0);
+				return;
+			}
+
+			for(unsigned int vbo : instance_vbos) if(vbo != 0) rlUnloadVertexBuffer(vbo);
+
+			instance_capacity = max<size_t>(count + count / 2, 1024);
+			positions.resize(instance_capacity);
+			colors.resize(instance_capacity);
+			data.resize(instance_capacity);
+
+			instance_vbos[INSTANCE_POSITION] = rlLoadVertexBuffer(positions.data(), (int)(instance_capacity * sizeof(Vector2)), true);
+			rlSetVertexAttribute(ATTRIB_POSITION, 2, RL_FLOAT, false, 0, 0);
+			instance_vbos[INSTANCE_COLOR] = rlLoadVertexBuffer(colors.data(), (int)(instance_capacity * sizeof(Color)), true);
+			rlSetVertexAttribute(ATTRIB_COLOR, 4, RL_UNSIGNED_BYTE, true, 0, 0);
+			instance_vbos[INSTANCE_DATA] = rlLoadVertexBuffer(data.data(), (int)(instance_capacity * sizeof(Color)), true);
+			rlSetVertexAttribute(ATTRIB_DATA, 4, RL_UNSIGNED_BYTE, false, 0, 0);
+
+			positions.resize(count);
+			colors.resize(count);
+			data.resize(count);
+
+			for(int attribute : { ATTRIB_POSITION, ATTRIB_COLOR, ATTRIB_DATA })
+			{
+				rlEnableVertexAttribute(attribute);
+				rlSetVertexAttributeDivisor(attribute, 1);
+			}
+		}
+
+		// NATO style symbols, dark on transparent, one ICON_SIZE square per division type
+		static vector<Color> buildAtlas()
+		{
+			const int width = ICON_SIZE * DIVISION_TYPE_COUNT;
+			vector<Color> pixels((size_t)width * ICON_SIZE, BLANK);
+
+			auto plot = [&](int type, int x, int y)
+			{
+				if(x < 0 || y < 0 || x >= ICON_SIZE || y >= ICON_SIZE) return;
+				pixels[(size_t)y * width + type * ICON_SIZE + x] = { 0, 0, 0, 255 };
+			};
+
+			const int margin = ICON_SIZE / 6;
+			const int last = ICON_SIZE - 1 - margin;
+
+			// Infantry: crossed diagonals
+			for(int t = margin; t <= last; ++t)
+			{
+				for(int w = 0; w < 2; ++w)
+				{
+					plot(DIVISION_INFANTRY, t + w, t);
+					plot(DIVISION_INFANTRY, ICON_SIZE - 1 - t - w, t);
+				}
+			}
+
+			// Armour: the track outline
+			float cx = (ICON_SIZE - 1) * 0.5f, cy = (ICON_SIZE - 1) * 0.5f;
+			float rx = ICON_SIZE * 0.36f, ry = ICON_SIZE * 0.22f;
+
+			for(int y = 0; y < ICON_SIZE; ++y)
+			{
+				for(int x = 0; x < ICON_SIZE; ++x)
+				{
+					float dx = (x - cx) / rx, dy = (y - cy) / ry;
+					float d = sqrtf(dx * dx + dy * dy);
+					if(d > 0.82f && d < 1.0f) plot(DIVISION_ARMOUR, x, y);
+				}
+			}
+
+			return pixels;
+		}
+};